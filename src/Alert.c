@@ -0,0 +1,179 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Alerts
+
+  @File Name
+    Alert.c
+
+  @Summary
+    Rule based brady/tachy, missing pulse and rate of change alerts
+
+  @Description
+    Implements functions that move each rule between idle, pending (condition
+    holds, waiting for its duration) and active on beat and reset events
+******************************************************************************/
+
+#include "Alert.h"
+
+// moves a rule along for one event, set tells if the condition holds and clear if the alert may clear
+static void evaluate(alert_rule_t * rule, uint64_t time, bool set, bool clear, uint8_t bpm) {
+    if(rule->active) {
+        if(clear) {
+            rule->active = false;
+            rule->pending = false;
+            if(rule->callback != NULL) {
+                rule->callback(rule->ctx, rule, false, bpm);
+            }
+        }
+        return;
+    }
+
+    if(!set) {
+        rule->pending = false;
+        return;
+    }
+    if(!rule->pending) {
+        rule->pending = true;
+        rule->since = time;
+    }
+    if(time - rule->since >= rule->duration_ms) {
+        rule->active = true;
+        if(rule->callback != NULL) {
+            rule->callback(rule->ctx, rule, true, bpm);
+        }
+    }
+}
+
+/*
+    @brief sets up a rule
+    @param Rule Pointer to alert rule
+    @param type rule type
+    @param threshold BPM, or BPM per second for ALERT_RATE_OF_CHANGE, unused for ALERT_NO_PULSE
+    @param hysteresis BPM (per second) past the threshold the value must go back before the alert clears
+    @param duration_ms condition must hold this long before the alert fires
+    @param callback called when the alert becomes active and when it clears
+    @param ctx passed back to callback
+    @retval None
+*/
+void alert_rule_init(alert_rule_t * Rule, alert_type_t type, float threshold, float hysteresis, uint32_t duration_ms, alert_callback_t callback, void * ctx) {
+    Rule->type = type;
+    Rule->threshold = threshold;
+    Rule->hysteresis = hysteresis;
+    Rule->duration_ms = duration_ms;
+    Rule->callback = callback;
+    Rule->ctx = ctx;
+    Rule->active = false;
+    Rule->pending = false;
+    Rule->since = 0;
+}
+
+/*
+    @brief alert engine initialization
+    @note takes the pulse sensor's current beat and reset, so a beat or reset from before init is not reported
+    @param Alert Pointer to alert handler
+    @param Pulse Sensor Pointer to pulse sensor handler passed to alert_update()
+    @param rules rules set up with alert_rule_init()
+    @param count number of rules
+    @retval None
+*/
+void alert_init(alert_t * Alert, pulse_sensor_t * PS, alert_rule_t * rules, uint8_t count) {
+    Alert->rules = rules;
+    Alert->count = count;
+    Alert->last_bpm = 0;
+    Alert->last_time = 0;
+    Alert->beat_count = PS->beat_count;
+    Alert->reset_count = PS->reset_count;
+}
+
+/*
+    @brief evaluates every rule for a beat
+    @param Alert Pointer to alert handler
+    @param time beat time (ms)
+    @param bpm BPM after the beat, 0 while the pulse sensor has no BPM yet
+    @retval None
+*/
+void alert_on_beat(alert_t * Alert, uint64_t time, uint8_t bpm) {
+    float rate = 0;
+    bool has_rate = Alert->last_bpm > 0 && bpm > 0 && time > Alert->last_time;
+    if(has_rate) {
+        rate = ((float)bpm - Alert->last_bpm) * 1000.0f / (float)(time - Alert->last_time);
+        if(rate < 0) {
+            rate = -rate;
+        }
+    }
+
+    for(uint8_t i = 0; i < Alert->count; i++) {
+        alert_rule_t * rule = &Alert->rules[i];
+        switch(rule->type) {
+            case ALERT_BPM_ABOVE:
+                if(bpm > 0) {
+                    evaluate(rule, time, bpm > rule->threshold, bpm < rule->threshold - rule->hysteresis, bpm);
+                }
+                break;
+            case ALERT_BPM_BELOW:
+                if(bpm > 0) {
+                    evaluate(rule, time, bpm < rule->threshold, bpm > rule->threshold + rule->hysteresis, bpm);
+                }
+                break;
+            case ALERT_NO_PULSE:
+                evaluate(rule, time, false, true, bpm);
+                break;
+            case ALERT_RATE_OF_CHANGE:
+                if(has_rate) {
+                    evaluate(rule, time, rate > rule->threshold, rate < rule->threshold - rule->hysteresis, bpm);
+                }
+                break;
+        }
+    }
+
+    Alert->last_bpm = bpm;
+    Alert->last_time = time;
+}
+
+/*
+    @brief evaluates every rule for a pulse sensor reset
+    @note BPM and rate of change alerts clear, there is no BPM to hold them until the next beat
+    @param Alert Pointer to alert handler
+    @param time reset time (ms)
+    @retval None
+*/
+void alert_on_reset(alert_t * Alert, uint64_t time) {
+    for(uint8_t i = 0; i < Alert->count; i++) {
+        alert_rule_t * rule = &Alert->rules[i];
+        if(rule->type == ALERT_NO_PULSE) {
+            evaluate(rule, time, true, false, 0);
+        }
+        else {
+            evaluate(rule, time, false, true, 0); // no BPM across a reset, clear and start counting again after it
+        }
+    }
+
+    Alert->last_bpm = 0;
+}
+
+/*
+    @brief calls alert_on_beat() and alert_on_reset() for pulse sensor events
+    @note call right after pulse_sensor_process_sample(), detects beats from beat_count and resets
+          from reset_count, so take_start_of_beat() is left for the application, O(1) without events
+    @param Alert Pointer to alert handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void alert_update(alert_t * Alert, pulse_sensor_t * PS) {
+    if(PS->reset_count != Alert->reset_count) {
+        Alert->reset_count = PS->reset_count;
+        alert_on_reset(Alert, PS->sample_counter);
+    }
+    if(PS->beat_count != Alert->beat_count) {
+        Alert->beat_count = PS->beat_count;
+        alert_on_beat(Alert, PS->last_beat_time, PS->BPM);
+    }
+}
+
+/*
+    @brief returns true while the alert of a rule is active
+    @param Rule Pointer to alert rule
+    @retval active value
+*/
+bool is_alert_active(const alert_rule_t * Rule) {
+    return Rule->active;
+}
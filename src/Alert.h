@@ -0,0 +1,123 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Alerts
+
+  @File Name
+    Alert.h
+
+  @Summary
+    Rule based brady/tachy, missing pulse and rate of change alerts
+
+  @Description
+    Defines functions that evaluate alert rules incrementally on each beat
+    and on each 2.5 second reset instead of polling BPM. Every rule has a
+    threshold, a hysteresis to clear it and a duration the condition must
+    hold before its callback fires, and costs O(1) per event.
+******************************************************************************/
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ALERT_BPM_ABOVE, // BPM above threshold, clears below threshold - hysteresis
+    ALERT_BPM_BELOW, // BPM below threshold, clears above threshold + hysteresis
+    ALERT_NO_PULSE, // pulse sensor reset (no beat for 2.5 seconds), clears on the next beat
+    ALERT_RATE_OF_CHANGE // BPM changing faster than threshold (BPM per second), clears below threshold - hysteresis
+}alert_type_t;
+
+struct alert_rule;
+typedef void (*alert_callback_t)(void * ctx, const struct alert_rule * rule, bool active, uint8_t bpm);
+
+typedef struct alert_rule {
+    // rule settings
+    alert_type_t type;
+    float threshold;
+    float hysteresis;
+    uint32_t duration_ms; // condition must hold this long before the alert fires, 0 to fire at once
+    alert_callback_t callback; // called when the alert becomes active and when it clears
+    void * ctx; // passed back to callback
+
+    // rule internal variables
+    bool active; // alert fired and not cleared yet
+    bool pending; // condition holds, waiting for duration_ms
+    uint64_t since; // time (ms) the condition started to hold
+}alert_rule_t;
+
+typedef struct {
+    alert_rule_t * rules;
+    uint8_t count; // number of rules
+    uint8_t last_bpm; // BPM of the previous beat, 0 if there was none since the last reset
+    uint64_t last_time; // time (ms) of the previous beat
+    uint32_t beat_count; // beat_count seen by alert_update()
+    uint32_t reset_count; // reset_count seen by alert_update()
+}alert_t;
+
+/*
+    @brief sets up a rule
+    @param Rule Pointer to alert rule
+    @param type rule type
+    @param threshold BPM, or BPM per second for ALERT_RATE_OF_CHANGE, unused for ALERT_NO_PULSE
+    @param hysteresis BPM (per second) past the threshold the value must go back before the alert clears
+    @param duration_ms condition must hold this long before the alert fires
+    @param callback called when the alert becomes active and when it clears
+    @param ctx passed back to callback
+    @retval None
+*/
+void alert_rule_init(alert_rule_t * Rule, alert_type_t type, float threshold, float hysteresis, uint32_t duration_ms, alert_callback_t callback, void * ctx);
+
+/*
+    @brief alert engine initialization
+    @note takes the pulse sensor's current beat and reset, so a beat or reset from before init is not reported
+    @param Alert Pointer to alert handler
+    @param Pulse Sensor Pointer to pulse sensor handler passed to alert_update()
+    @param rules rules set up with alert_rule_init()
+    @param count number of rules
+    @retval None
+*/
+void alert_init(alert_t * Alert, pulse_sensor_t * Pulse_Sensor, alert_rule_t * rules, uint8_t count);
+
+/*
+    @brief evaluates every rule for a beat
+    @param Alert Pointer to alert handler
+    @param time beat time (ms)
+    @param bpm BPM after the beat, 0 while the pulse sensor has no BPM yet
+    @retval None
+*/
+void alert_on_beat(alert_t * Alert, uint64_t time, uint8_t bpm);
+
+/*
+    @brief evaluates every rule for a pulse sensor reset
+    @note BPM and rate of change alerts clear, there is no BPM to hold them until the next beat
+    @param Alert Pointer to alert handler
+    @param time reset time (ms)
+    @retval None
+*/
+void alert_on_reset(alert_t * Alert, uint64_t time);
+
+/*
+    @brief calls alert_on_beat() and alert_on_reset() for pulse sensor events
+    @note call right after pulse_sensor_process_sample(), detects beats from beat_count and resets
+          from reset_count, so take_start_of_beat() is left for the application, O(1) without events
+    @param Alert Pointer to alert handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void alert_update(alert_t * Alert, pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief returns true while the alert of a rule is active
+    @param Rule Pointer to alert rule
+    @retval active value
+*/
+bool is_alert_active(const alert_rule_t * Rule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALERT_H
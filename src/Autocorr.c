@@ -0,0 +1,181 @@
+/* ****************************************************************************/
+/** Autocorrelation Heart Rate Estimator
+
+  @File Name
+    Autocorr.c
+
+  @Summary
+    Calculates BPM from the autocorrelation of the analog signal
+
+  @Description
+    Implements functions for a BPM source that keeps working while the threshold
+    detector is stuck resetting, lag correlations over a decimated sliding
+    window are updated incrementally instead of recomputed. Built with AVX2
+    (-mavx2 or -march=native on x86) four lags are updated per instruction.
+******************************************************************************/
+
+#include "Autocorr.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define AUTOCORR_BASELINE_SHIFT 32 // baseline follows 1/32 of each decimated sample (~1.3 s)
+#define AUTOCORR_HARMONIC_RATIO 0.7f // shortest lag within this ratio of the best wins, avoids locking onto 1/2 BPM
+
+static void estimate(autocorr_bpm_t * AC) {
+    if(AC->energy <= 0) {
+        AC->BPM = 0;
+        AC->confidence = 0;
+        return;
+    }
+
+    uint8_t best = 0;
+    for(uint8_t i = 1; i < AUTOCORR_LAGS; i++) {
+        if(AC->corr[i] > AC->corr[best]) {
+            best = i;
+        }
+    }
+
+    // prefer the first local maximum that is close to the best, multiples of the period correlate too
+    for(uint8_t i = 1; i + 1 < best; i++) {
+        if(AC->corr[i] >= AC->corr[i-1] && AC->corr[i] >= AC->corr[i+1] &&
+           AC->corr[i] >= AUTOCORR_HARMONIC_RATIO * AC->corr[best]) {
+            best = i;
+            break;
+        }
+    }
+
+    // parabolic interpolation between neighbouring lags
+    float offset = 0;
+    if(best > 0 && best < AUTOCORR_LAGS - 1) {
+        float a = AC->corr[best-1], b = AC->corr[best], c = AC->corr[best+1];
+        float denom = a - 2*b + c;
+        if(denom != 0) {
+            offset = 0.5f * (a - c) / denom;
+        }
+    }
+
+    float lag = AUTOCORR_MIN_LAG + best + offset;
+    AC->BPM = (uint8_t)(60000.0f / (lag * AUTOCORR_PERIOD_MS) + 0.5f);
+
+    float confidence = (float)AC->corr[best] / AC->energy;
+    AC->confidence = confidence < 0 ? 0 : confidence > 1 ? 1 : confidence;
+}
+
+#if defined(__AVX2__)
+// sliding update of every lag, four 64 bit correlations at a time
+static void update_lags(int64_t * corr, const int16_t * newest, const int16_t * oldest) {
+    const __m256i x_new = _mm256_set1_epi64x(newest[0]);
+    const __m256i x_old = _mm256_set1_epi64x(oldest[0]);
+    uint8_t i = 0;
+    for(; i + 4 <= AUTOCORR_LAGS; i += 4) {
+        // lags i..i+3 are at descending addresses, load them upward and reverse the lanes
+        const int16_t * n = newest - (AUTOCORR_MIN_LAG + i + 3);
+        const int16_t * o = oldest - (AUTOCORR_MIN_LAG + i + 3);
+        __m256i lag_new = _mm256_permute4x64_epi64(_mm256_cvtepi16_epi64(_mm_loadl_epi64((const __m128i *)n)), 0x1B);
+        __m256i lag_old = _mm256_permute4x64_epi64(_mm256_cvtepi16_epi64(_mm_loadl_epi64((const __m128i *)o)), 0x1B);
+        __m256i delta = _mm256_sub_epi64(_mm256_mul_epi32(x_new, lag_new), _mm256_mul_epi32(x_old, lag_old));
+        __m256i sum = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(corr + i)), delta);
+        _mm256_storeu_si256((__m256i *)(corr + i), sum);
+    }
+    for(; i < AUTOCORR_LAGS; i++) {
+        corr[i] += (int64_t)newest[0]*newest[-(AUTOCORR_MIN_LAG + i)] - (int64_t)oldest[0]*oldest[-(AUTOCORR_MIN_LAG + i)];
+    }
+}
+#else
+// sliding update of every lag
+static void update_lags(int64_t * corr, const int16_t * newest, const int16_t * oldest) {
+    for(uint8_t i = 0; i < AUTOCORR_LAGS; i++) {
+        corr[i] += (int64_t)newest[0]*newest[-(AUTOCORR_MIN_LAG + i)] - (int64_t)oldest[0]*oldest[-(AUTOCORR_MIN_LAG + i)];
+    }
+}
+#endif
+
+static void push_sample(autocorr_bpm_t * AC, int16_t x) {
+    AC->head = (AC->head + 1) % AUTOCORR_HISTORY;
+    AC->history[AC->head] = x;
+    AC->history[AC->head + AUTOCORR_HISTORY] = x;
+
+    // newest[-i] is the sample i decimated periods ago, zero before the history has filled
+    const int16_t * newest = &AC->history[AC->head + AUTOCORR_HISTORY];
+    const int16_t * oldest = newest - AUTOCORR_WINDOW; // sample leaving the window
+    int32_t x_new = newest[0];
+    int32_t x_old = oldest[0];
+
+    AC->energy += (int64_t)x_new*x_new - (int64_t)x_old*x_old;
+
+    update_lags(AC->corr, newest, oldest);
+
+    if(AC->filled < AUTOCORR_HISTORY) {
+        AC->filled++;
+    }
+    if(AC->filled >= AUTOCORR_WINDOW) {
+        estimate(AC);
+    }
+}
+
+/*
+    @brief autocorrelation estimator initialization
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval None
+*/
+void autocorr_bpm_init(autocorr_bpm_t * AC) {
+    memset(AC, 0, sizeof(*AC));
+}
+
+/*
+    @brief processes the latest sample value
+    @note call alongside pulse_sensor_process_sample(), reads signal from the pulse sensor
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void autocorr_bpm_process_sample(autocorr_bpm_t * AC, pulse_sensor_t * PS, uint32_t ms) {
+    AC->accumulator += PS->signal;
+    AC->accumulated++;
+    AC->accumulated_ms += ms;
+
+    if(AC->accumulated_ms < AUTOCORR_PERIOD_MS) {
+        return;
+    }
+
+    float x = AC->accumulator / AC->accumulated;
+    AC->accumulator = 0;
+    AC->accumulated = 0;
+    AC->accumulated_ms -= AUTOCORR_PERIOD_MS;
+
+    if(AC->filled == 0) {
+        AC->baseline = x; // seed with the first decimated sample
+    }
+    AC->baseline += (x - AC->baseline) / AUTOCORR_BASELINE_SHIFT; // remove DC and slow wander
+
+    float scaled = (x - AC->baseline) * AUTOCORR_SCALE;
+    if(scaled > INT16_MAX) {
+        scaled = INT16_MAX;
+    }
+    else if(scaled < -INT16_MAX) {
+        scaled = -INT16_MAX;
+    }
+    push_sample(AC, (int16_t)scaled);
+}
+
+/*
+    @brief get the autocorrelation bpm measurement
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval BPM value
+*/
+uint8_t get_autocorr_beats_per_minute(autocorr_bpm_t * AC) {
+    return AC->BPM;
+}
+
+/*
+    @brief get confidence of the autocorrelation bpm measurement
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval confidence, 0-1
+*/
+float get_autocorr_confidence(autocorr_bpm_t * AC) {
+    return AC->confidence;
+}
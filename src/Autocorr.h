@@ -0,0 +1,87 @@
+/* ****************************************************************************/
+/** Autocorrelation Heart Rate Estimator
+
+  @File Name
+    Autocorr.h
+
+  @Summary
+    Calculates BPM from the autocorrelation of the analog signal
+
+  @Description
+    Defines functions for a BPM source that keeps working while the threshold
+    detector is stuck resetting, lag correlations over a decimated sliding
+    window are updated incrementally instead of recomputed
+******************************************************************************/
+
+#ifndef AUTOCORR_H
+#define AUTOCORR_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOCORR_PERIOD_MS 40 // samples are averaged down to this period (25 Hz)
+#define AUTOCORR_WINDOW 128 // decimated samples in the correlation window (~5 seconds)
+#define AUTOCORR_MIN_BPM 40
+#define AUTOCORR_MAX_BPM 220
+#define AUTOCORR_MIN_LAG ((60000 + AUTOCORR_MAX_BPM * AUTOCORR_PERIOD_MS - 1) / (AUTOCORR_MAX_BPM * AUTOCORR_PERIOD_MS)) // rounded up, no lag above AUTOCORR_MAX_BPM
+#define AUTOCORR_MAX_LAG (60000 / (AUTOCORR_MIN_BPM * AUTOCORR_PERIOD_MS) + 1)
+#define AUTOCORR_LAGS (AUTOCORR_MAX_LAG - AUTOCORR_MIN_LAG + 1)
+#define AUTOCORR_HISTORY (AUTOCORR_WINDOW + AUTOCORR_MAX_LAG + 1) // samples needed to update the window
+#define AUTOCORR_SCALE 16384.0f // sample value to fixed point, keeps sums exact
+
+typedef struct {
+    // autocorrelation output variables
+    uint8_t BPM; // beats per minute of the best lag, 0 until the window is full
+    float confidence; // normalized correlation at the best lag, 0-1
+
+    // autocorrelation internal variables
+    int16_t history[2 * AUTOCORR_HISTORY]; // each sample is written twice so the history is always contiguous
+    uint16_t head; // index of the newest sample in the first half of history
+    uint16_t filled; // decimated samples seen, saturates at AUTOCORR_HISTORY
+    float baseline; // slow average removed from the signal
+    float accumulator; // sum of samples being decimated
+    uint16_t accumulated; // number of samples in accumulator
+    uint32_t accumulated_ms; // time (ms) covered by accumulator
+    int64_t energy; // correlation at lag 0
+    int64_t corr[AUTOCORR_LAGS]; // correlation at AUTOCORR_MIN_LAG..AUTOCORR_MAX_LAG
+}autocorr_bpm_t;
+
+/*
+    @brief autocorrelation estimator initialization
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval None
+*/
+void autocorr_bpm_init(autocorr_bpm_t * Autocorr);
+
+/*
+    @brief processes the latest sample value
+    @note call alongside pulse_sensor_process_sample(), reads signal from the pulse sensor
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void autocorr_bpm_process_sample(autocorr_bpm_t * Autocorr, pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+/*
+    @brief get the autocorrelation bpm measurement
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval BPM value
+*/
+uint8_t get_autocorr_beats_per_minute(autocorr_bpm_t * Autocorr);
+
+/*
+    @brief get confidence of the autocorrelation bpm measurement
+    @param Autocorr Pointer to autocorrelation estimator handler
+    @retval confidence, 0-1
+*/
+float get_autocorr_confidence(autocorr_bpm_t * Autocorr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUTOCORR_H
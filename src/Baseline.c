@@ -0,0 +1,128 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Baseline Removal
+
+  @File Name
+    Baseline.c
+
+  @Summary
+    Constant cost moving average baseline removal
+
+  @Description
+    Implements the running sum moving average. Adding the new sample and
+    subtracting the oldest lets float rounding build up in the sum, so a
+    second sum is started every time the window wraps and replaces it after
+    one full window, which bounds the error without an O(length) pass.
+******************************************************************************/
+
+#include "Baseline.h"
+
+/*
+    @brief baseline stage initialization
+    @param Baseline Pointer to baseline handler
+    @param window caller provided buffer of length samples
+    @param length samples in the moving average window
+    @param center value the output is centered on, BASELINE_CENTER for the pulse sensor defaults
+    @retval true if initialized, false if window is NULL or length is 0
+*/
+bool baseline_init(baseline_t * B, float * window, uint16_t length, float center) {
+    if(window == NULL || length == 0) {
+        return false;
+    }
+    B->window = window;
+    B->length = length;
+    B->center = center;
+    B->head = 0;
+    B->count = 0;
+    B->sum = 0;
+    B->lap_sum = 0;
+    return true;
+}
+
+/*
+    @brief removes the baseline from one sample
+    @note O(1) for any window length
+    @param Baseline Pointer to baseline handler
+    @param sample latest sample
+    @retval sample minus the moving average, plus center
+*/
+float baseline_remove(baseline_t * B, float sample) {
+    if(B->count == B->length) {
+        B->sum -= B->window[B->head]; // drop the oldest sample
+    }
+    else {
+        B->count++;
+    }
+    B->window[B->head] = sample;
+    B->sum += sample;
+    B->lap_sum += sample;
+
+    B->head++;
+    if(B->head == B->length) {
+        B->head = 0;
+        if(B->count == B->length) {
+            B->sum = B->lap_sum; // the lap covered the whole window, it has no drift
+        }
+        B->lap_sum = 0;
+    }
+
+    return sample - B->sum / B->count + B->center;
+}
+
+/*
+    @brief removes the baseline from the pulse sensor's signal and processes it
+    @note set signal first as for pulse_sensor_process_sample()
+    @param Baseline Pointer to baseline handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void baseline_process_sample(baseline_t * B, pulse_sensor_t * PS, uint32_t ms) {
+    PS->signal = baseline_remove(B, PS->signal);
+    pulse_sensor_process_sample(PS, ms);
+}
+
+/*
+    @brief integer baseline stage initialization
+    @param Baseline Pointer to integer baseline handler
+    @param window caller provided buffer of length samples
+    @param length samples in the moving average window
+    @param center value the output is centered on (counts)
+    @retval true if initialized, false if window is NULL or length is 0
+*/
+bool baseline_int_init(baseline_int_t * B, int32_t * window, uint16_t length, int32_t center) {
+    if(window == NULL || length == 0) {
+        return false;
+    }
+    B->window = window;
+    B->length = length;
+    B->center = center;
+    B->head = 0;
+    B->count = 0;
+    B->sum = 0;
+    return true;
+}
+
+/*
+    @brief removes the baseline from one ADC sample
+    @note O(1) for any window length
+    @param Baseline Pointer to integer baseline handler
+    @param sample latest sample (counts)
+    @retval sample minus the moving average, plus center (counts)
+*/
+int32_t baseline_int_remove(baseline_int_t * B, int32_t sample) {
+    if(B->count == B->length) {
+        B->sum -= B->window[B->head]; // drop the oldest sample
+    }
+    else {
+        B->count++;
+    }
+    B->window[B->head] = sample;
+    B->sum += sample;
+
+    B->head++;
+    if(B->head == B->length) {
+        B->head = 0;
+    }
+
+    return sample - (int32_t)(B->sum / B->count) + B->center;
+}
@@ -0,0 +1,109 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Baseline Removal
+
+  @File Name
+    Baseline.h
+
+  @Summary
+    Constant cost moving average baseline removal
+
+  @Description
+    Defines functions for a stage in front of pulse_sensor_process_sample()
+    that subtracts a moving average of the last window of samples (a one
+    stage CIC filter kept as a running sum), so baseline wander does not push
+    the pulse away from thresh_setting and the 0.6 V peak/trough defaults.
+    The output is zero centered and then moved to a center value, which is
+    BASELINE_CENTER (the middle of the 0-1.2 V input range) by default so the
+    detector's defaults hold. A float and an integer (ADC counts) version are
+    provided, the integer one is exact and needs no floating point.
+******************************************************************************/
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BASELINE_CENTER 0.6f // output center, the peak/trough seed of the pulse sensor
+
+typedef struct {
+    // baseline settings
+    float * window; // caller provided, length samples
+    uint16_t length; // samples averaged, about 1.5 seconds is longer than any beat
+    float center; // added back to the zero centered output
+
+    // baseline internal variables
+    uint16_t head; // next index to write, also the oldest sample once full
+    uint16_t count; // samples in the window, up to length
+    float sum; // running sum of the window
+    float lap_sum; // sum of the samples since head was last 0, replaces sum when head wraps
+}baseline_t;
+
+typedef struct {
+    // baseline settings
+    int32_t * window; // caller provided, length samples
+    uint16_t length; // samples averaged
+    int32_t center; // added back to the zero centered output
+
+    // baseline internal variables
+    uint16_t head;
+    uint16_t count;
+    int64_t sum; // exact for any length and sample
+}baseline_int_t;
+
+/*
+    @brief baseline stage initialization
+    @param Baseline Pointer to baseline handler
+    @param window caller provided buffer of length samples
+    @param length samples in the moving average window
+    @param center value the output is centered on, BASELINE_CENTER for the pulse sensor defaults
+    @retval true if initialized, false if window is NULL or length is 0
+*/
+bool baseline_init(baseline_t * Baseline, float * window, uint16_t length, float center);
+
+/*
+    @brief removes the baseline from one sample
+    @note O(1) for any window length
+    @param Baseline Pointer to baseline handler
+    @param sample latest sample
+    @retval sample minus the moving average, plus center
+*/
+float baseline_remove(baseline_t * Baseline, float sample);
+
+/*
+    @brief removes the baseline from the pulse sensor's signal and processes it
+    @note set signal first as for pulse_sensor_process_sample()
+    @param Baseline Pointer to baseline handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void baseline_process_sample(baseline_t * Baseline, pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+/*
+    @brief integer baseline stage initialization
+    @param Baseline Pointer to integer baseline handler
+    @param window caller provided buffer of length samples
+    @param length samples in the moving average window
+    @param center value the output is centered on (counts)
+    @retval true if initialized, false if window is NULL or length is 0
+*/
+bool baseline_int_init(baseline_int_t * Baseline, int32_t * window, uint16_t length, int32_t center);
+
+/*
+    @brief removes the baseline from one ADC sample
+    @note O(1) for any window length
+    @param Baseline Pointer to integer baseline handler
+    @param sample latest sample (counts)
+    @retval sample minus the moving average, plus center (counts)
+*/
+int32_t baseline_int_remove(baseline_int_t * Baseline, int32_t sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BASELINE_H
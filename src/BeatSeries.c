@@ -0,0 +1,384 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Beat Series
+
+  @File Name
+    BeatSeries.c
+
+  @Summary
+    Append-only compressed store of beat events in fixed size pages
+
+  @Description
+    Implements the page coding. Time, IBI and BPM residuals share one
+    variable length code:
+        '0'                 0
+        '10'   + 7 bits     zigzag value below 2^7
+        '110'  + 9 bits     zigzag value below 2^9
+        '1110' + 12 bits    zigzag value below 2^12
+        '1111' + 32 bits    anything else
+    Amplitude is XORed with the previous amplitude:
+        '0'                 same value
+        '10'  + bits        meaningful bits fit the previous window
+        '11'  + 5 bits leading zeros + 5 bits length - 1 + bits
+******************************************************************************/
+
+#include "BeatSeries.h"
+#include <string.h>
+
+#define NO_WINDOW 32 // leading value before the first XOR window of a page
+
+static void put_le(uint8_t * data, uint64_t value, uint8_t bytes) {
+    for(uint8_t i = 0; i < bytes; i++) {
+        data[i] = (uint8_t)(value >> (8*i));
+    }
+}
+
+static uint64_t get_le(const uint8_t * data, uint8_t bytes) {
+    uint64_t value = 0;
+    for(uint8_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)data[i] << (8*i);
+    }
+    return value;
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint8_t leading_zeros(uint32_t value) {
+    uint8_t zeros = 0;
+    while(zeros < 32 && !(value & 0x80000000u)) {
+        value <<= 1;
+        zeros++;
+    }
+    return zeros;
+}
+
+static uint8_t trailing_zeros(uint32_t value) {
+    uint8_t zeros = 0;
+    while(zeros < 32 && !(value & 1)) {
+        value >>= 1;
+        zeros++;
+    }
+    return zeros;
+}
+
+static bool fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static void put_code(bit_writer_t * w, int32_t value) {
+    uint32_t z = zigzag_encode(value);
+    if(z == 0) {
+        bit_write(w, 0, 1);
+    }
+    else if(z < (1u << 7)) {
+        bit_write(w, 0x1, 2); // '10'
+        bit_write(w, z, 7);
+    }
+    else if(z < (1u << 9)) {
+        bit_write(w, 0x3, 3); // '110'
+        bit_write(w, z, 9);
+    }
+    else if(z < (1u << 12)) {
+        bit_write(w, 0x7, 4); // '1110'
+        bit_write(w, z, 12);
+    }
+    else {
+        bit_write(w, 0xF, 4); // '1111'
+        bit_write(w, z, 32);
+    }
+}
+
+static int32_t get_code(bit_reader_t * r) {
+    static const uint8_t widths[5] = {0, 7, 9, 12, 32};
+    uint8_t ones = 0;
+    while(ones < 4 && bit_read(r, 1)) {
+        ones++;
+    }
+    return ones == 0 ? 0 : zigzag_decode(bit_read(r, widths[ones]));
+}
+
+static void put_xor(bit_writer_t * w, uint32_t value, uint32_t previous, uint8_t * leading, uint8_t * trailing) {
+    uint32_t x = value ^ previous;
+    if(x == 0) {
+        bit_write(w, 0, 1);
+        return;
+    }
+    uint8_t lead = leading_zeros(x);
+    uint8_t trail = trailing_zeros(x);
+    if(lead > 31) {
+        lead = 31;
+    }
+    if(lead >= *leading && trail >= *trailing) {
+        bit_write(w, 0x1, 2); // '10'
+        bit_write(w, x >> *trailing, (uint8_t)(32 - *leading - *trailing));
+        return;
+    }
+    uint8_t length = (uint8_t)(32 - lead - trail);
+    bit_write(w, 0x3, 2); // '11'
+    bit_write(w, lead, 5);
+    bit_write(w, length - 1, 5);
+    bit_write(w, x >> trail, length);
+    *leading = lead;
+    *trailing = trail;
+}
+
+static uint32_t get_xor(bit_reader_t * r, uint32_t previous, uint8_t * leading, uint8_t * trailing) {
+    if(!bit_read(r, 1)) {
+        return previous;
+    }
+    if(bit_read(r, 1)) {
+        *leading = (uint8_t)bit_read(r, 5);
+        uint8_t length = (uint8_t)(bit_read(r, 5) + 1);
+        *trailing = (uint8_t)(32 - *leading - length);
+    }
+    uint8_t length = (uint8_t)(32 - *leading - *trailing);
+    return previous ^ (bit_read(r, length) << *trailing);
+}
+
+static void start_page(beat_series_t * S) {
+    bit_writer_init(&S->writer, S->page + BEAT_SERIES_HEADER, BEAT_SERIES_PAGE_SIZE - BEAT_SERIES_HEADER);
+    S->count = 0;
+}
+
+// header plus coded beats of the page being filled, pending bits included
+static void build_page(beat_series_t * S, uint8_t * data) {
+    if(data != S->page) {
+        memcpy(data + BEAT_SERIES_HEADER, S->page + BEAT_SERIES_HEADER, S->writer.pos);
+    }
+    memset(data + BEAT_SERIES_HEADER + S->writer.pos, 0, BEAT_SERIES_PAGE_SIZE - BEAT_SERIES_HEADER - S->writer.pos);
+    if(S->writer.count > 0) {
+        data[BEAT_SERIES_HEADER + S->writer.pos] = (uint8_t)S->writer.bits;
+    }
+    put_le(data, BEAT_SERIES_MAGIC, 2);
+    put_le(data + 2, S->count, 2);
+    put_le(data + 4, S->first_time, 8);
+    put_le(data + 12, S->last_time, 8);
+}
+
+static bool seal_page(beat_series_t * S) {
+    build_page(S, S->page);
+    if(!S->storage.write_page(S->storage.ctx, S->pages, S->page)) {
+        return false;
+    }
+    S->index[S->pages].first_time = S->first_time;
+    S->index[S->pages].last_time = S->last_time;
+    S->pages++;
+    start_page(S);
+    return true;
+}
+
+static uint32_t decode_page(const uint8_t * data, uint64_t from, uint64_t to, beat_series_callback_t callback, void * ctx) {
+    if(get_le(data, 2) != BEAT_SERIES_MAGIC) {
+        return 0;
+    }
+    uint16_t count = (uint16_t)get_le(data + 2, 2);
+    bit_reader_t reader;
+    bit_reader_init(&reader, data + BEAT_SERIES_HEADER, BEAT_SERIES_PAGE_SIZE - BEAT_SERIES_HEADER);
+
+    beat_record_t beat;
+    beat.time = get_le(data + 4, 8);
+    beat.IBI = bit_read(&reader, 32);
+    beat.BPM = (uint8_t)bit_read(&reader, 8);
+    uint32_t amplitude = bit_read(&reader, 32);
+    beat.amplitude = bits_float(amplitude);
+    int64_t delta = beat.IBI > INT32_MAX ? INT32_MAX : beat.IBI;
+    uint8_t leading = NO_WINDOW;
+    uint8_t trailing = 0;
+    uint32_t found = 0;
+
+    for(uint16_t i = 0; i < count && beat.time <= to; i++) {
+        if(i > 0) {
+            delta += get_code(&reader);
+            beat.time += (uint64_t)delta;
+            beat.IBI = (uint32_t)(delta + get_code(&reader));
+            beat.BPM = (uint8_t)(beat.BPM + get_code(&reader));
+            amplitude = get_xor(&reader, amplitude, &leading, &trailing);
+            beat.amplitude = bits_float(amplitude);
+            if(reader.overrun || beat.time > to) {
+                break;
+            }
+        }
+        if(beat.time >= from) {
+            callback(ctx, &beat);
+            found++;
+        }
+    }
+
+    return found;
+}
+
+/*
+    @brief starts an empty series
+    @param Series Pointer to beat series handler
+    @param storage page storage interface
+    @param index RAM index, one entry per page
+    @param max_pages number of entries in index, pages the storage can hold
+    @retval None
+*/
+void beat_series_init(beat_series_t * S, beat_storage_t storage, beat_page_index_t * index, uint32_t max_pages) {
+    S->storage = storage;
+    S->index = index;
+    S->max_pages = max_pages;
+    S->pages = 0;
+    S->first_time = 0;
+    S->last_time = 0;
+    start_page(S);
+}
+
+/*
+    @brief opens a series stored before, rebuilds the index from the page headers
+    @note new beats go into the page after the last stored page
+    @param Series Pointer to beat series handler
+    @param storage page storage interface
+    @param index RAM index, one entry per page
+    @param max_pages number of entries in index, pages the storage can hold
+    @retval number of pages found
+*/
+uint32_t beat_series_open(beat_series_t * S, beat_storage_t storage, beat_page_index_t * index, uint32_t max_pages) {
+    beat_series_init(S, storage, index, max_pages);
+
+    while(S->pages < max_pages && storage.read_page(storage.ctx, S->pages, S->page)) {
+        if(get_le(S->page, 2) != BEAT_SERIES_MAGIC || get_le(S->page + 2, 2) == 0) {
+            break; // erased or never written
+        }
+        index[S->pages].first_time = get_le(S->page + 4, 8);
+        index[S->pages].last_time = get_le(S->page + 12, 8);
+        S->pages++;
+    }
+
+    start_page(S);
+    return S->pages;
+}
+
+/*
+    @brief appends a beat
+    @note beat times must not decrease, a full page is written to storage
+    @param Series Pointer to beat series handler
+    @param beat beat to append
+    @retval false if the beat is older than the last one, the storage is full or a page write failed
+*/
+bool beat_series_append(beat_series_t * S, const beat_record_t * beat) {
+    uint64_t last_time = S->count > 0 ? S->last_time : (S->pages > 0 ? S->index[S->pages-1].last_time : 0);
+    if(beat->time < last_time) {
+        return false;
+    }
+
+    if(S->count > 0) {
+        uint64_t delta = beat->time - S->last_time;
+        size_t used = S->writer.pos + (S->writer.count > 0);
+        if(delta > INT32_MAX || !fits_int32((int64_t)beat->IBI - (int64_t)delta) ||
+           S->writer.size - used < BEAT_SERIES_MAX_BEAT_BYTES) {
+            if(!seal_page(S)) {
+                return false;
+            }
+        }
+    }
+
+    uint32_t amplitude = float_bits(beat->amplitude);
+    if(S->count == 0) {
+        if(S->pages >= S->max_pages) {
+            return false; // storage full
+        }
+        bit_write(&S->writer, beat->IBI, 32);
+        bit_write(&S->writer, beat->BPM, 8);
+        bit_write(&S->writer, amplitude, 32);
+        S->first_time = beat->time;
+        S->last_delta = beat->IBI > INT32_MAX ? INT32_MAX : beat->IBI; // next beat is expected one IBI later
+        S->leading = NO_WINDOW;
+        S->trailing = 0;
+    }
+    else {
+        int64_t delta = (int64_t)(beat->time - S->last_time);
+        put_code(&S->writer, (int32_t)(delta - S->last_delta));
+        put_code(&S->writer, (int32_t)((int64_t)beat->IBI - delta));
+        put_code(&S->writer, (int32_t)beat->BPM - S->last_BPM);
+        put_xor(&S->writer, amplitude, S->last_amplitude, &S->leading, &S->trailing);
+        S->last_delta = delta;
+    }
+
+    S->last_time = beat->time;
+    S->last_BPM = beat->BPM;
+    S->last_amplitude = amplitude;
+    S->count++;
+    return true;
+}
+
+/*
+    @brief appends the latest beat of the pulse sensor
+    @note call when take_start_of_beat() returns true
+    @param Series Pointer to beat series handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param time_base added to last_beat_time, e.g. wall clock time (ms) of heart_rate_init()
+    @retval false if the beat could not be stored
+*/
+bool beat_series_append_beat(beat_series_t * S, pulse_sensor_t * PS, uint64_t time_base) {
+    beat_record_t beat;
+    beat.time = time_base + PS->last_beat_time;
+    beat.IBI = PS->IBI;
+    beat.amplitude = PS->amplitude;
+    beat.BPM = PS->BPM;
+    return beat_series_append(S, &beat);
+}
+
+/*
+    @brief writes the page being filled to storage, even if it is not full
+    @note e.g. before power down, new beats start the next page
+    @param Series Pointer to beat series handler
+    @retval false if the page write failed or the storage is full
+*/
+bool beat_series_flush(beat_series_t * S) {
+    if(S->count == 0) {
+        return true;
+    }
+    return seal_page(S);
+}
+
+/*
+    @brief calls back every beat with from <= time <= to, oldest first
+    @note includes beats not written to storage yet, uses BEAT_SERIES_PAGE_SIZE bytes of stack
+    @param Series Pointer to beat series handler
+    @param from start of the range (ms)
+    @param to end of the range (ms)
+    @param callback called once per beat in the range
+    @param ctx passed back to callback
+    @retval number of beats in the range
+*/
+uint32_t beat_series_query(beat_series_t * S, uint64_t from, uint64_t to, beat_series_callback_t callback, void * ctx) {
+    uint8_t data[BEAT_SERIES_PAGE_SIZE];
+    uint32_t found = 0;
+
+    // first page that ends at or after from, page times never decrease
+    uint32_t low = 0;
+    uint32_t high = S->pages;
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if(S->index[mid].last_time < from) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    for(uint32_t page = low; page < S->pages && S->index[page].first_time <= to; page++) {
+        if(S->storage.read_page(S->storage.ctx, page, data)) {
+            found += decode_page(data, from, to, callback, ctx);
+        }
+    }
+
+    if(S->count > 0 && S->first_time <= to && S->last_time >= from) {
+        build_page(S, data);
+        found += decode_page(data, from, to, callback, ctx);
+    }
+
+    return found;
+}
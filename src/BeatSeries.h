@@ -0,0 +1,147 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Beat Series
+
+  @File Name
+    BeatSeries.h
+
+  @Summary
+    Append-only compressed store of beat events in fixed size pages
+
+  @Description
+    Defines functions that archive beat time, IBI, BPM and amplitude in
+    Gorilla style compressed pages: delta-of-delta timestamps, IBI coded
+    against the time since the previous beat, BPM deltas and XOR coded
+    amplitude. Pages go through a storage interface (flash pages on the
+    micro, a file on the host) and a RAM index of page time ranges finds
+    the pages of a range query with a binary search.
+
+    Page layout:
+        bytes 0-1    BEAT_SERIES_MAGIC
+        bytes 2-3    number of beats
+        bytes 4-11   time of the first beat (ms)
+        bytes 12-19  time of the last beat (ms)
+        bytes 20...  first beat IBI (32 bits), BPM (8 bits), amplitude (32 bits),
+                     then the coded beats, least significant bit first
+******************************************************************************/
+
+#ifndef BEAT_SERIES_H
+#define BEAT_SERIES_H
+
+#include "HeartRate.h"
+#include "BitPack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef BEAT_SERIES_PAGE_SIZE
+#define BEAT_SERIES_PAGE_SIZE 256 // bytes per page, e.g. the flash program page size
+#endif
+#define BEAT_SERIES_MAGIC 0x5342 // "BS" little endian
+#define BEAT_SERIES_HEADER 20 // bytes in front of the coded beats
+#define BEAT_SERIES_MAX_BEAT_BYTES 20 // most bytes a coded beat can take
+
+typedef struct {
+    uint64_t time; // beat time (ms), e.g. last_beat_time plus a wall clock base
+    uint32_t IBI; // inter beat interval (ms)
+    float amplitude; // pulse amplitude
+    uint8_t BPM; // beats per minute
+}beat_record_t;
+
+typedef struct {
+    bool (*write_page)(void * ctx, uint32_t page, const uint8_t * data); // stores BEAT_SERIES_PAGE_SIZE bytes, false on error
+    bool (*read_page)(void * ctx, uint32_t page, uint8_t * data); // loads BEAT_SERIES_PAGE_SIZE bytes, false if the page does not exist
+    void * ctx; // passed back to write_page and read_page, e.g. flash driver or file handle
+}beat_storage_t;
+
+typedef struct {
+    uint64_t first_time; // time of the first beat in the page (ms)
+    uint64_t last_time; // time of the last beat in the page (ms)
+}beat_page_index_t;
+
+typedef void (*beat_series_callback_t)(void * ctx, const beat_record_t * beat);
+
+typedef struct {
+    beat_storage_t storage;
+    beat_page_index_t * index; // time range of each stored page
+    uint32_t max_pages; // size of index
+    uint32_t pages; // pages stored
+
+    // page being filled
+    uint8_t page[BEAT_SERIES_PAGE_SIZE];
+    bit_writer_t writer; // writes the coded beats into page
+    uint16_t count; // beats in page
+    uint64_t first_time;
+    uint64_t last_time;
+    int64_t last_delta; // time (ms) between the last two beats, the IBI after the first beat
+    uint8_t last_BPM;
+    uint32_t last_amplitude; // bits of the last amplitude
+    uint8_t leading; // leading zero bits of the last XOR window
+    uint8_t trailing; // trailing zero bits of the last XOR window
+}beat_series_t;
+
+/*
+    @brief starts an empty series
+    @param Series Pointer to beat series handler
+    @param storage page storage interface
+    @param index RAM index, one entry per page
+    @param max_pages number of entries in index, pages the storage can hold
+    @retval None
+*/
+void beat_series_init(beat_series_t * Series, beat_storage_t storage, beat_page_index_t * index, uint32_t max_pages);
+
+/*
+    @brief opens a series stored before, rebuilds the index from the page headers
+    @note new beats go into the page after the last stored page
+    @param Series Pointer to beat series handler
+    @param storage page storage interface
+    @param index RAM index, one entry per page
+    @param max_pages number of entries in index, pages the storage can hold
+    @retval number of pages found
+*/
+uint32_t beat_series_open(beat_series_t * Series, beat_storage_t storage, beat_page_index_t * index, uint32_t max_pages);
+
+/*
+    @brief appends a beat
+    @note beat times must not decrease, a full page is written to storage
+    @param Series Pointer to beat series handler
+    @param beat beat to append
+    @retval false if the beat is older than the last one, the storage is full or a page write failed
+*/
+bool beat_series_append(beat_series_t * Series, const beat_record_t * beat);
+
+/*
+    @brief appends the latest beat of the pulse sensor
+    @note call when take_start_of_beat() returns true
+    @param Series Pointer to beat series handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param time_base added to last_beat_time, e.g. wall clock time (ms) of heart_rate_init()
+    @retval false if the beat could not be stored
+*/
+bool beat_series_append_beat(beat_series_t * Series, pulse_sensor_t * Pulse_Sensor, uint64_t time_base);
+
+/*
+    @brief writes the page being filled to storage, even if it is not full
+    @note e.g. before power down, new beats start the next page
+    @param Series Pointer to beat series handler
+    @retval false if the page write failed or the storage is full
+*/
+bool beat_series_flush(beat_series_t * Series);
+
+/*
+    @brief calls back every beat with from <= time <= to, oldest first
+    @note includes beats not written to storage yet, uses BEAT_SERIES_PAGE_SIZE bytes of stack
+    @param Series Pointer to beat series handler
+    @param from start of the range (ms)
+    @param to end of the range (ms)
+    @param callback called once per beat in the range
+    @param ctx passed back to callback
+    @retval number of beats in the range
+*/
+uint32_t beat_series_query(beat_series_t * Series, uint64_t from, uint64_t to, beat_series_callback_t callback, void * ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BEAT_SERIES_H
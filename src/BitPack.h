@@ -0,0 +1,158 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Bit Packing
+
+  @File Name
+    BitPack.h
+
+  @Summary
+    Bit writer and reader shared by the compressed sample and beat formats
+
+  @Description
+    Defines static inline functions that pack values of any width up to 32
+    bits into a byte buffer, least significant bit first, and read them back,
+    plus zigzag coding that maps signed residuals to small unsigned values
+******************************************************************************/
+
+#ifndef BIT_PACK_H
+#define BIT_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t * data;
+    size_t size; // size of data (bytes)
+    size_t pos; // next byte to write
+    uint64_t bits; // bits not written to data yet
+    uint8_t count; // number of bits in bits, less than 8 between calls
+    bool overflow; // set once data was too small, later writes are dropped
+}bit_writer_t;
+
+typedef struct {
+    const uint8_t * data;
+    size_t size; // size of data (bytes)
+    size_t pos; // next byte to read
+    uint64_t bits; // bits read from data and not returned yet
+    uint8_t count; // number of bits in bits
+    bool overrun; // set once more bits were read than data holds, they read as 0
+}bit_reader_t;
+
+static inline void bit_writer_init(bit_writer_t * Writer, uint8_t * data, size_t size) {
+    Writer->data = data;
+    Writer->size = size;
+    Writer->pos = 0;
+    Writer->bits = 0;
+    Writer->count = 0;
+    Writer->overflow = false;
+}
+
+/*
+    @brief appends the low width bits of value
+    @param width 0-32
+*/
+static inline void bit_write(bit_writer_t * Writer, uint32_t value, uint8_t width) {
+    if(width == 0) {
+        return;
+    }
+    if(width < 32) {
+        value &= ((uint32_t)1 << width) - 1;
+    }
+    Writer->bits |= (uint64_t)value << Writer->count;
+    Writer->count += width;
+    while(Writer->count >= 8) {
+        if(Writer->pos < Writer->size) {
+            Writer->data[Writer->pos++] = (uint8_t)Writer->bits;
+        }
+        else {
+            Writer->overflow = true;
+        }
+        Writer->bits >>= 8;
+        Writer->count -= 8;
+    }
+}
+
+/*
+    @brief writes the last partial byte, padded with 0 bits
+    @retval bytes used, 0 if data was too small
+*/
+static inline size_t bit_writer_flush(bit_writer_t * Writer) {
+    if(Writer->count > 0) {
+        bit_write(Writer, 0, (uint8_t)(8 - Writer->count));
+    }
+    return Writer->overflow ? 0 : Writer->pos;
+}
+
+static inline void bit_reader_init(bit_reader_t * Reader, const uint8_t * data, size_t size) {
+    Reader->data = data;
+    Reader->size = size;
+    Reader->pos = 0;
+    Reader->bits = 0;
+    Reader->count = 0;
+    Reader->overrun = false;
+}
+
+/*
+    @brief reads the next width bits
+    @param width 0-32
+*/
+static inline uint32_t bit_read(bit_reader_t * Reader, uint8_t width) {
+    if(width == 0) {
+        return 0;
+    }
+    while(Reader->count < width) {
+        if(Reader->pos < Reader->size) {
+            Reader->bits |= (uint64_t)Reader->data[Reader->pos++] << Reader->count;
+        }
+        else {
+            Reader->overrun = true;
+        }
+        Reader->count += 8;
+    }
+    uint32_t value = (uint32_t)Reader->bits;
+    if(width < 32) {
+        value &= ((uint32_t)1 << width) - 1;
+    }
+    Reader->bits >>= width;
+    Reader->count -= width;
+    return value;
+}
+
+/*
+    @brief bytes consumed so far, the partial byte counts as used
+*/
+static inline size_t bit_reader_position(const bit_reader_t * Reader) {
+    if(Reader->overrun) {
+        return Reader->size;
+    }
+    return Reader->pos - Reader->count / 8;
+}
+
+// number of bits needed to hold value, 0 for 0
+static inline uint8_t bit_width(uint32_t value) {
+    uint8_t width = 0;
+    while(value != 0) {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+// 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+static inline uint32_t zigzag_encode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIT_PACK_H
@@ -0,0 +1,195 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Threshold Calibration
+
+  @File Name
+    Calibration.c
+
+  @Summary
+    Automatic thresh, peak, trough and amplitude from the first seconds of signal
+
+  @Description
+    Implements the P² running percentile (Jain and Chlamtac) and the stage
+    that applies it. Low and high percentiles are used instead of the minimum
+    and maximum so a single spike or dropout does not set the range.
+******************************************************************************/
+
+#include "Calibration.h"
+
+static void sort5(float * v, uint8_t count) {
+    for(uint8_t i = 1; i < count; i++) {
+        float x = v[i];
+        uint8_t j = i;
+        for(; j > 0 && v[j-1] > x; j--) {
+            v[j] = v[j-1];
+        }
+        v[j] = x;
+    }
+}
+
+/*
+    @brief running percentile initialization
+    @param Percentile Pointer to percentile handler
+    @param p percentile to track, 0 to 1
+    @retval None
+*/
+void calibration_percentile_init(calibration_percentile_t * P, float p) {
+    P->count = 0;
+    P->np[0] = 0;
+    P->np[1] = 2 * p;
+    P->np[2] = 4 * p;
+    P->np[3] = 2 + 2 * p;
+    P->np[4] = 4;
+    P->dn[0] = 0;
+    P->dn[1] = p / 2;
+    P->dn[2] = p;
+    P->dn[3] = (1 + p) / 2;
+    P->dn[4] = 1;
+}
+
+/*
+    @brief adds one sample to a running percentile
+    @param Percentile Pointer to percentile handler
+    @param x sample value
+    @retval None
+*/
+void calibration_percentile_add(calibration_percentile_t * P, float x) {
+    if(P->count < 5) {
+        P->q[P->count++] = x;
+        if(P->count == 5) {
+            sort5(P->q, 5);
+            for(uint8_t i = 0; i < 5; i++) {
+                P->n[i] = i;
+            }
+        }
+        return;
+    }
+    P->count++;
+
+    // find the cell x falls in and stretch the end markers to it
+    uint8_t k;
+    if(x < P->q[0]) {
+        P->q[0] = x;
+        k = 0;
+    }
+    else if(x >= P->q[4]) {
+        P->q[4] = x;
+        k = 3;
+    }
+    else {
+        for(k = 0; x >= P->q[k+1]; k++);
+    }
+    for(uint8_t i = k + 1; i < 5; i++) {
+        P->n[i]++;
+    }
+    for(uint8_t i = 0; i < 5; i++) {
+        P->np[i] += P->dn[i];
+    }
+
+    // move the middle markers toward their desired positions
+    for(uint8_t i = 1; i < 4; i++) {
+        float d = P->np[i] - P->n[i];
+        if((d >= 1 && P->n[i+1] - P->n[i] > 1) || (d <= -1 && P->n[i-1] - P->n[i] < -1)) {
+            float s = d > 0 ? 1 : -1;
+            float q = P->q[i] + s / (P->n[i+1] - P->n[i-1]) *
+                ((P->n[i] - P->n[i-1] + s) * (P->q[i+1] - P->q[i]) / (P->n[i+1] - P->n[i]) +
+                 (P->n[i+1] - P->n[i] - s) * (P->q[i] - P->q[i-1]) / (P->n[i] - P->n[i-1])); // parabolic
+            if(q <= P->q[i-1] || q >= P->q[i+1]) {
+                uint8_t j = d > 0 ? i + 1 : i - 1;
+                q = P->q[i] + s * (P->q[j] - P->q[i]) / (P->n[j] - P->n[i]); // linear
+            }
+            P->q[i] = q;
+            P->n[i] += s;
+        }
+    }
+}
+
+/*
+    @brief get the running percentile estimate
+    @param Percentile Pointer to percentile handler
+    @retval estimate, exact for up to 5 samples, 0 without samples
+*/
+float calibration_percentile_get(calibration_percentile_t * P) {
+    if(P->count >= 5) {
+        return P->q[2];
+    }
+    if(P->count == 0) {
+        return 0;
+    }
+    float v[5];
+    for(uint8_t i = 0; i < P->count; i++) {
+        v[i] = P->q[i];
+    }
+    sort5(v, (uint8_t)P->count);
+    return v[(uint8_t)(P->dn[2] * (float)(P->count - 1) + 0.5f)];
+}
+
+// moves the pulse sensor's time on and leaves the raw sample in signal, no reset is checked
+static void advance_time(pulse_sensor_t * PS, uint32_t ms) {
+    PS->prev_signal = PS->signal;
+    PS->sample_counter += ms;
+    PS->N = PS->sample_counter - PS->last_beat_time;
+}
+
+static void start(calibration_t * C) {
+    C->calibrating = true;
+    C->elapsed = 0;
+    calibration_percentile_init(&C->low, CALIBRATION_LOW);
+    calibration_percentile_init(&C->high, CALIBRATION_HIGH);
+}
+
+/*
+    @brief calibration stage initialization, the first calibration starts with the next sample
+    @note heart_rate_init() must be called first, set_threshold() is not needed
+    @param Calibration Pointer to calibration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void calibration_init(calibration_t * C, pulse_sensor_t * PS) {
+    C->calibrations = 0;
+    C->reset_count = PS->reset_count;
+    start(C);
+}
+
+/*
+    @brief calibrates on or processes the latest sample
+    @note set signal first as for pulse_sensor_process_sample(), while calibrating the pulse sensor only
+          advances sample_counter and N (signal keeps the sample) and the first beat is timed from the end
+          of calibration, after a reset the next samples calibrate again, sample at CALIBRATION_MIN_RATE_HZ
+          or faster
+    @param Calibration Pointer to calibration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval true if the sample completed a calibration
+*/
+bool calibration_process_sample(calibration_t * C, pulse_sensor_t * PS, uint32_t ms) {
+    bool done = false;
+    if(C->calibrating) {
+        calibration_percentile_add(&C->low, PS->signal);
+        calibration_percentile_add(&C->high, PS->signal);
+        C->elapsed += ms;
+        if(C->elapsed < CALIBRATION_MS) {
+            advance_time(PS, ms);
+            return false;
+        }
+
+        float trough = calibration_percentile_get(&C->low);
+        float peak = calibration_percentile_get(&C->high);
+        PS->trough = trough;
+        PS->peak = peak;
+        PS->amplitude = peak - trough;
+        PS->thresh = trough + PS->amplitude / 2;
+        PS->thresh_setting = PS->thresh; // seed for the reset, until the next calibration replaces it
+        PS->last_beat_time = PS->sample_counter; // time the first beat from here, not from the start of calibration
+        PS->N = 0;
+        C->calibrating = false;
+        C->calibrations++;
+        done = true;
+    }
+
+    pulse_sensor_process_sample(PS, ms);
+    if(PS->reset_count != C->reset_count) {
+        C->reset_count = PS->reset_count;
+        start(C); // the signal was lost, its level may have changed
+    }
+    return done;
+}
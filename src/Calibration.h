@@ -0,0 +1,101 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Threshold Calibration
+
+  @File Name
+    Calibration.h
+
+  @Summary
+    Automatic thresh, peak, trough and amplitude from the first seconds of signal
+
+  @Description
+    Defines functions for a stage that wraps pulse_sensor_process_sample().
+    For the first CALIBRATION_MS of signal, and again after every 2.5 second
+    reset, it tracks low and high running percentiles of the samples with the
+    P² algorithm (five markers each, no sample buffer) and then seeds the
+    pulse sensor from them instead of the hand set thresh_setting.
+******************************************************************************/
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CALIBRATION_MS 1250 // signal (ms) to calibrate on
+#define CALIBRATION_MIN_RATE_HZ 50 // lowest sample rate, P² needs about 60 samples in CALIBRATION_MS
+#define CALIBRATION_LOW 0.10f // percentile taken as the trough
+#define CALIBRATION_HIGH 0.90f // percentile taken as the peak
+
+typedef struct {
+    float q[5]; // marker heights
+    float n[5]; // marker positions
+    float np[5]; // desired marker positions
+    float dn[5]; // desired position increments
+    uint32_t count; // samples added
+}calibration_percentile_t;
+
+typedef struct {
+    // calibration output variables
+    bool calibrating; // samples are going to the percentiles, not the detector
+    uint32_t calibrations; // completed calibrations
+
+    // calibration internal variables
+    calibration_percentile_t low;
+    calibration_percentile_t high;
+    uint32_t elapsed; // ms of signal in this calibration
+    uint32_t reset_count; // reset_count seen, a change is a reset
+}calibration_t;
+
+/*
+    @brief calibration stage initialization, the first calibration starts with the next sample
+    @note heart_rate_init() must be called first, set_threshold() is not needed
+    @param Calibration Pointer to calibration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void calibration_init(calibration_t * Calibration, pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief calibrates on or processes the latest sample
+    @note set signal first as for pulse_sensor_process_sample(), while calibrating the pulse sensor only
+          advances sample_counter and N (signal keeps the sample) and the first beat is timed from the end
+          of calibration, after a reset the next samples calibrate again, sample at CALIBRATION_MIN_RATE_HZ
+          or faster
+    @param Calibration Pointer to calibration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval true if the sample completed a calibration
+*/
+bool calibration_process_sample(calibration_t * Calibration, pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+/*
+    @brief running percentile initialization
+    @param Percentile Pointer to percentile handler
+    @param p percentile to track, 0 to 1
+    @retval None
+*/
+void calibration_percentile_init(calibration_percentile_t * Percentile, float p);
+
+/*
+    @brief adds one sample to a running percentile
+    @param Percentile Pointer to percentile handler
+    @param x sample value
+    @retval None
+*/
+void calibration_percentile_add(calibration_percentile_t * Percentile, float x);
+
+/*
+    @brief get the running percentile estimate
+    @param Percentile Pointer to percentile handler
+    @retval estimate, exact for up to 5 samples, 0 without samples
+*/
+float calibration_percentile_get(calibration_percentile_t * Percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALIBRATION_H
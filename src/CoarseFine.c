@@ -0,0 +1,119 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Coarse/Fine Detection
+
+  @File Name
+    CoarseFine.c
+
+  @Summary
+    Two tier offline detection that skips blocks which cannot hold a beat
+
+  @Description
+    Implements the coarse pass and the one step update. With every sample
+    below thresh and no pulse in progress, pulse_sensor_process_sample()
+    cannot find a peak, a beat or the end of a beat, and with N staying
+    within PULSE_RESET_MS it cannot reset, which leaves only the updates
+    applied here. The coarse loop is branch free, but gcc only vectorizes
+    its float max and min with -ffast-math, so it is scalar in a normal
+    build. The speed up comes from skipping the detector, not from SIMD.
+******************************************************************************/
+
+#include "CoarseFine.h"
+
+/*
+    @brief coarse/fine pipeline initialization
+    @note heart_rate_init() and set_threshold() must be called on the pulse sensor first
+    @param CoarseFine Pointer to coarse/fine handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param block samples per coarse block, COARSE_FINE_BLOCK for the default
+    @param on_beat beat callback, the pulse sensor holds the beat's last_beat_time, IBI and BPM when it is called
+    @param ctx passed to on_beat
+    @retval None
+*/
+void coarse_fine_init(coarse_fine_t * CF, pulse_sensor_t * PS, uint16_t block, coarse_fine_beat_t on_beat, void * ctx) {
+    CF->sensor = PS;
+    CF->block = block > 0 ? block : COARSE_FINE_BLOCK;
+    CF->on_beat = on_beat;
+    CF->ctx = ctx;
+    CF->coarse_blocks = 0;
+    CF->fine_blocks = 0;
+}
+
+// first sample index at which N passes the trough gate of 3/5 IBI
+static size_t trough_start(pulse_sensor_t * PS, size_t n, uint32_t ms) {
+    int64_t need = (int64_t)((PS->IBI/5)*3) - (int64_t)(PS->sample_counter - PS->last_beat_time);
+    if(need < 0) {
+        return 0;
+    }
+    if(ms == 0) {
+        return n; // N never grows
+    }
+    uint64_t start = (uint64_t)need / ms; // sample i has N = old N + (i + 1) * ms
+    return start < n ? (size_t)start : n;
+}
+
+// applies a block if it cannot change anything but timing, trough and counters, returns false to process it sample by sample
+static bool coarse_block(pulse_sensor_t * PS, const float * s, size_t n, uint32_t ms) {
+    if(PS->pulse || PS->sample_counter + (uint64_t)n * ms - PS->last_beat_time > PULSE_RESET_MS) {
+        return false;
+    }
+
+    size_t gate = trough_start(PS, n, ms);
+    float max = s[0];
+    float min = PS->trough;
+    uint32_t clipped = 0;
+    for(size_t i = 0; i < n; i++) {
+        max = s[i] > max ? s[i] : max;
+        min = (i >= gate && s[i] < min) ? s[i] : min;
+        clipped += (s[i] <= PULSE_SENSOR_CLIP_LOW) | (s[i] >= PULSE_SENSOR_CLIP_HIGH);
+    }
+    if(!(max < PS->thresh)) {
+        return false; // a peak or beat may be in this block
+    }
+
+    PS->sample_counter += (uint64_t)n * ms;
+    PS->N = PS->sample_counter - PS->last_beat_time;
+    PS->beat_samples += (uint32_t)n;
+    PS->clipped_samples += clipped;
+    PS->trough = min;
+    PS->signal = s[n-1];
+    PS->prev_signal = s[n-1];
+    return true;
+}
+
+/*
+    @brief processes samples of a recording
+    @note may be called repeatedly with consecutive parts of a recording, any length
+    @param CoarseFine Pointer to coarse/fine handler
+    @param samples samples, taken every ms
+    @param count number of samples
+    @param ms time (ms) between samples
+    @retval beats found in these samples
+*/
+uint32_t coarse_fine_process(coarse_fine_t * CF, const float * samples, size_t count, uint32_t ms) {
+    pulse_sensor_t * PS = CF->sensor;
+    uint32_t beats = 0;
+
+    for(size_t pos = 0; pos < count; pos += CF->block) {
+        size_t n = count - pos < CF->block ? count - pos : CF->block;
+        const float * s = samples + pos;
+
+        if(coarse_block(PS, s, n, ms)) {
+            CF->coarse_blocks++;
+            continue;
+        }
+
+        CF->fine_blocks++;
+        for(size_t i = 0; i < n; i++) {
+            PS->signal = s[i];
+            pulse_sensor_process_sample(PS, ms);
+            if(take_start_of_beat(PS)) {
+                beats++;
+                if(CF->on_beat != NULL) {
+                    CF->on_beat(CF->ctx, PS);
+                }
+            }
+        }
+    }
+
+    return beats;
+}
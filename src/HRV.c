@@ -0,0 +1,157 @@
+/* ****************************************************************************/
+/** Heart Rate Variability
+
+  @File Name
+    HRV.c
+
+  @Summary
+    Streaming HRV metrics (RMSSD, SDNN, pNN50)
+
+  @Description
+    Implements functions that keep exact integer running sums over a window of
+    beats so each accepted beat is O(1) to add, the metrics are O(1) to read
+    and removing beats from the sums does not drift over a long session
+******************************************************************************/
+
+#include "HRV.h"
+#include <math.h>
+
+static uint8_t ring_index(hrv_t * HRV, uint8_t i) {
+    return (HRV->oldest + i) % HRV_MAX_BEATS;
+}
+
+static void add_successive_difference(hrv_t * HRV, uint32_t a, uint32_t b, int sign) {
+    int64_t diff = (int64_t)b - (int64_t)a;
+    uint64_t sq = (uint64_t)(diff * diff);
+
+    if(sign > 0) {
+        HRV->sum_sq_diff += sq;
+        HRV->nn50 += (diff > 50 || diff < -50);
+    }
+    else {
+        HRV->sum_sq_diff -= sq;
+        HRV->nn50 -= (diff > 50 || diff < -50);
+    }
+}
+
+static void drop_oldest(hrv_t * HRV) {
+    uint32_t ibi = HRV->ibi[HRV->oldest];
+
+    if(HRV->count > 1) {
+        add_successive_difference(HRV, ibi, HRV->ibi[ring_index(HRV, 1)], -1);
+    }
+
+    HRV->oldest = ring_index(HRV, 1);
+    HRV->count--;
+    HRV->total_ibi -= ibi;
+    HRV->total_ibi_sq -= (uint64_t)ibi * ibi;
+}
+
+/*
+    @brief hrv initialization
+    @param HRV Pointer to hrv handler
+    @param max_beats beat window, clamped to HRV_MAX_BEATS
+    @param window_ms time window (ms), 0 to only use the beat window
+    @retval None
+*/
+void hrv_init(hrv_t * HRV, uint8_t max_beats, uint32_t window_ms) {
+    if(max_beats > HRV_MAX_BEATS) {
+        max_beats = HRV_MAX_BEATS;
+    }
+    if(max_beats < 2) {
+        max_beats = 2; // need two beats for a difference
+    }
+    HRV->max_beats = max_beats;
+    HRV->window_ms = window_ms;
+    hrv_reset(HRV);
+}
+
+/*
+    @brief clear all beats from the window
+    @note call after a pulse sensor reset, IBIs on either side of it are not successive
+    @param HRV Pointer to hrv handler
+    @retval None
+*/
+void hrv_reset(hrv_t * HRV) {
+    HRV->oldest = 0;
+    HRV->count = 0;
+    HRV->total_ibi = 0;
+    HRV->total_ibi_sq = 0;
+    HRV->sum_sq_diff = 0;
+    HRV->nn50 = 0;
+}
+
+/*
+    @brief add an accepted beat
+    @note call once per beat, e.g. when take_start_of_beat() returns true
+    @param HRV Pointer to hrv handler
+    @param ibi inter beat interval of the beat (ms)
+    @retval None
+*/
+void hrv_add_beat(hrv_t * HRV, uint32_t ibi) {
+    if(HRV->count == HRV->max_beats) {
+        drop_oldest(HRV); // make room in the ring
+    }
+
+    if(HRV->count > 0) {
+        add_successive_difference(HRV, HRV->ibi[ring_index(HRV, HRV->count - 1)], ibi, 1);
+    }
+
+    HRV->ibi[ring_index(HRV, HRV->count)] = ibi;
+    HRV->count++;
+    HRV->total_ibi += ibi;
+    HRV->total_ibi_sq += (uint64_t)ibi * ibi;
+
+    // drop beats that fell out of the time window, amortized O(1) since each beat is dropped once
+    while(HRV->window_ms && HRV->count > 1 && HRV->total_ibi > HRV->window_ms) {
+        drop_oldest(HRV);
+    }
+}
+
+/*
+    @brief get the number of beats in the window
+    @param HRV Pointer to hrv handler
+    @retval beat count
+*/
+uint8_t hrv_get_beat_count(hrv_t * HRV) {
+    return HRV->count;
+}
+
+/*
+    @brief get root mean square of successive IBI differences
+    @param HRV Pointer to hrv handler
+    @retval RMSSD (ms), 0 with less than 2 beats
+*/
+float hrv_get_rmssd(hrv_t * HRV) {
+    if(HRV->count < 2) {
+        return 0;
+    }
+    return sqrtf((float)HRV->sum_sq_diff / (HRV->count - 1));
+}
+
+/*
+    @brief get standard deviation of IBI values
+    @param HRV Pointer to hrv handler
+    @retval SDNN (ms), 0 with less than 2 beats
+*/
+float hrv_get_sdnn(hrv_t * HRV) {
+    if(HRV->count < 2) {
+        return 0;
+    }
+    // n * sum(x^2) - sum(x)^2 is exact in integers, fits for IBIs below 2^25 ms with HRV_MAX_BEATS 64
+    uint64_t n = HRV->count;
+    uint64_t spread = n * HRV->total_ibi_sq - HRV->total_ibi * HRV->total_ibi;
+    return sqrtf((float)spread / (float)(n * (n - 1)));
+}
+
+/*
+    @brief get percentage of successive IBI differences greater than 50 ms
+    @param HRV Pointer to hrv handler
+    @retval pNN50 (%), 0 with less than 2 beats
+*/
+float hrv_get_pnn50(hrv_t * HRV) {
+    if(HRV->count < 2) {
+        return 0;
+    }
+    return 100.0f * HRV->nn50 / (HRV->count - 1);
+}
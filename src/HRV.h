@@ -0,0 +1,100 @@
+/* ****************************************************************************/
+/** Heart Rate Variability
+
+  @File Name
+    HRV.h
+
+  @Summary
+    Streaming HRV metrics (RMSSD, SDNN, pNN50)
+
+  @Description
+    Defines functions that keep running sums over a window of beats so each
+    accepted beat is O(1) to add and the metrics are O(1) to read
+******************************************************************************/
+
+#ifndef HRV_H
+#define HRV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HRV_MAX_BEATS 64 // largest beat window supported
+
+typedef struct {
+    // window settings
+    uint8_t max_beats; // beat window, at most HRV_MAX_BEATS
+    uint32_t window_ms; // time window (ms), sum of IBIs kept, 0 to only use the beat window
+
+    // internal variables
+    uint32_t ibi[HRV_MAX_BEATS]; // ring buffer of IBI values in the window (ms)
+    uint8_t oldest; // index of the oldest IBI in the ring
+    uint8_t count; // number of IBI values in the window
+    uint64_t total_ibi; // sum of IBI values in the window (ms)
+    uint64_t total_ibi_sq; // sum of squared IBI values in the window (ms^2), exact so it cannot drift
+    uint64_t sum_sq_diff; // sum of squared successive IBI differences (ms^2)
+    uint32_t nn50; // successive differences greater than 50 ms
+}hrv_t;
+
+/*
+    @brief hrv initialization
+    @param HRV Pointer to hrv handler
+    @param max_beats beat window, clamped to HRV_MAX_BEATS
+    @param window_ms time window (ms), 0 to only use the beat window
+    @retval None
+*/
+void hrv_init(hrv_t * HRV, uint8_t max_beats, uint32_t window_ms);
+
+/*
+    @brief clear all beats from the window
+    @note call after a pulse sensor reset, IBIs on either side of it are not successive
+    @param HRV Pointer to hrv handler
+    @retval None
+*/
+void hrv_reset(hrv_t * HRV);
+
+/*
+    @brief add an accepted beat
+    @note call once per beat, e.g. when take_start_of_beat() returns true
+    @param HRV Pointer to hrv handler
+    @param ibi inter beat interval of the beat (ms)
+    @retval None
+*/
+void hrv_add_beat(hrv_t * HRV, uint32_t ibi);
+
+/*
+    @brief get the number of beats in the window
+    @param HRV Pointer to hrv handler
+    @retval beat count
+*/
+uint8_t hrv_get_beat_count(hrv_t * HRV);
+
+/*
+    @brief get root mean square of successive IBI differences
+    @param HRV Pointer to hrv handler
+    @retval RMSSD (ms), 0 with less than 2 beats
+*/
+float hrv_get_rmssd(hrv_t * HRV);
+
+/*
+    @brief get standard deviation of IBI values
+    @param HRV Pointer to hrv handler
+    @retval SDNN (ms), 0 with less than 2 beats
+*/
+float hrv_get_sdnn(hrv_t * HRV);
+
+/*
+    @brief get percentage of successive IBI differences greater than 50 ms
+    @param HRV Pointer to hrv handler
+    @retval pNN50 (%), 0 with less than 2 beats
+*/
+float hrv_get_pnn50(hrv_t * HRV);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HRV_H
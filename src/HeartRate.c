@@ -15,6 +15,69 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define QUALITY_SHIFT 8 // running averages follow 1/8 of each new value
+#define QUALITY_AMPLITUDE_SPREAD 0.5f // relative amplitude deviation that scores 0
+#define QUALITY_IBI_SPREAD 0.2f // relative IBI deviation that scores 0
+#define QUALITY_CLIP_RATE 0.1f // share of clipped samples that scores 0
+#define QUALITY_MIN_RATIO 0.1f // amplitude relative to trough that scores 100
+
+static float clamp_unit(float x) {
+    return x < 0 ? 0 : x > 1 ? 1 : x;
+}
+
+static float deviation(float a, float b) {
+    return a > b ? a - b : b - a;
+}
+
+// update the running averages used by the quality index with the samples since the last beat or reset
+static void update_clip_rate(pulse_sensor_t * PS) {
+    if(PS->beat_samples > 0) {
+        float clipped = (float)PS->clipped_samples / PS->beat_samples;
+        PS->clip_rate += (clipped - PS->clip_rate) / QUALITY_SHIFT;
+    }
+    PS->beat_samples = 0;
+    PS->clipped_samples = 0;
+}
+
+static void update_quality(pulse_sensor_t * PS) {
+    float amplitude_score = PS->amplitude_mean > 0 ? 1 - clamp_unit(PS->amplitude_deviation / PS->amplitude_mean / QUALITY_AMPLITUDE_SPREAD) : 0;
+    float IBI_score = 1 - clamp_unit(PS->IBI_deviation / PS->IBI_mean / QUALITY_IBI_SPREAD);
+    float reset_score = 1 - clamp_unit(PS->reset_rate);
+    float clip_score = 1 - clamp_unit(PS->clip_rate / QUALITY_CLIP_RATE);
+    float trough = PS->trough < 0 ? -PS->trough : PS->trough;
+    float ratio_score = trough > 0 ? clamp_unit(PS->amplitude / trough / QUALITY_MIN_RATIO) : 1;
+
+    // any one bad component is enough to make the output unusable
+    PS->quality = (uint8_t)(100 * amplitude_score * IBI_score * reset_score * clip_score * ratio_score + 0.5f);
+}
+
+// if 2.5 seconds go by without a beat
+static void check_reset(pulse_sensor_t * PS) {
+    if(PS->N > PULSE_RESET_MS) {
+#ifdef DEBUG_OUTPUT
+        LOG("\tTime since last beat (N = %d) is greater than 2.5 seconds, so reset variables\n", PS->N);
+#endif
+        PS->thresh = PS->thresh_setting;
+        PS->peak = 0.6;
+        PS->trough = 0.6;
+        PS->last_beat_time = PS->sample_counter; // bring last beat time up to date
+        PS->beat_offset = 0;
+        PS->first_beat = true;
+        PS->second_beat = false;
+        PS->warm_start = false;
+        PS->start_of_beat = false;
+        PS->BPM = 0;
+        PS->IBI = 600; // 600ms per beat = 100 bpm
+        PS->pulse = false;
+        PS->amplitude = 0.12;
+
+        PS->reset_count++;
+        PS->reset_rate += (1 - PS->reset_rate) / QUALITY_SHIFT;
+        update_clip_rate(PS);
+        update_quality(PS);
+    }
+}
+
 /*
     @brief heart rate sensor initialization
     @note sets default variables
@@ -22,6 +85,7 @@
     @retval None
 */
 void heart_rate_init(pulse_sensor_t * PS) {
+    PS->interpolate = false;
     reset_variables(PS);
 }
 
@@ -31,7 +95,7 @@ void heart_rate_init(pulse_sensor_t * PS) {
     @retval None
 */
 void reset_variables(pulse_sensor_t * PS) {
-    memset(PS->rate, 0, 10);
+    memset(PS->rate, 0, sizeof(PS->rate));
     PS->start_of_beat = false;
     PS->BPM = 0;
     PS->IBI = 750; // 750 ms per beat = 80 bpm
@@ -44,6 +108,20 @@ void reset_variables(pulse_sensor_t * PS) {
     PS->amplitude = 0.12; // amp at 1/10 of input range 
     PS->first_beat = true; // looking for first beat
     PS->second_beat = false;
+    PS->warm_start = false;
+    PS->prev_signal = PS->thresh;
+    PS->beat_offset = 0;
+    PS->quality = 0;
+    PS->reset_count = 0;
+    PS->beat_count = 0;
+    PS->amplitude_mean = PS->amplitude;
+    PS->amplitude_deviation = 0;
+    PS->IBI_mean = PS->IBI;
+    PS->IBI_deviation = 0;
+    PS->reset_rate = 0;
+    PS->clip_rate = 0;
+    PS->beat_samples = 0;
+    PS->clipped_samples = 0;
 }
 
 /*
@@ -86,7 +164,8 @@ uint32_t get_inter_beat_interval(pulse_sensor_t * PS) {
 }
 
 /*
-    @brief reads and clears saw start of beat flag
+    @brief returns the saw start of beat flag
+    @note the flag stays set after a beat until take_start_of_beat() or a reset clears it
     @param Pulse Sensor Pointer to pulse sensor handler
     @retval start_of_beat value
 */
@@ -94,6 +173,18 @@ bool saw_start_of_beat(pulse_sensor_t * PS) {
     return PS->start_of_beat;
 }
 
+/*
+    @brief reads and clears saw start of beat flag
+    @note reports each beat once, for code that polls after every sample
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval start_of_beat value
+*/
+bool take_start_of_beat(pulse_sensor_t * PS) {
+    bool start_of_beat = PS->start_of_beat;
+    PS->start_of_beat = false; // so each beat is only reported once
+    return start_of_beat;
+}
+
 /*
     @brief returns true if the pulse sensor is inside of a heart beat
     @param Pulse Sensor Pointer to pulse sensor handler
@@ -121,6 +212,60 @@ uint32_t get_last_beat_time(pulse_sensor_t * PS) {
     return PS->last_beat_time;
 }
 
+/*
+    @brief turn beat time interpolation on or off
+    @note beat time is normally the first sample above thresh, so IBI resolution is the
+          sample period, with interpolation the thresh crossing between samples is used
+          so lower sample rates give the same IBI precision, off after heart_rate_init()
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param interpolate true to interpolate beat time
+    @retval None
+*/
+void set_beat_interpolation(pulse_sensor_t * PS, bool interpolate) {
+    PS->interpolate = interpolate;
+}
+
+/*
+    @brief returns how long before last_beat_time the interpolated beat happened
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval beat_offset value (ms), 0 without interpolation
+*/
+float get_beat_offset(pulse_sensor_t * PS) {
+    return PS->beat_offset;
+}
+
+/*
+    @brief get the signal quality index
+    @note combines amplitude stability, IBI variance, reset frequency, clipping and peak/trough ratio,
+          use it to suppress or slow down outputs when the signal is bad
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval quality value, 0 (garbage) to 100 (clean)
+*/
+uint8_t get_signal_quality(pulse_sensor_t * PS) {
+    return PS->quality;
+}
+
+/*
+    @brief get the number of 2.5 second resets since init
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval reset_count value
+*/
+uint32_t get_reset_count(pulse_sensor_t * PS) {
+    return PS->reset_count;
+}
+
+/*
+    @brief get the number of beats detected since init
+    @note counts every thresh crossing taken as a beat, including the first one after a reset
+          whose IBI is discarded, last_beat_time also moves on resets, resumes and seeding so
+          watch this instead to find beats
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval beat_count value
+*/
+uint32_t get_beat_count(pulse_sensor_t * PS) {
+    return PS->beat_count;
+}
+
 /*
     @brief processes the latest sample value
     @note calculates BPM, IBI, etc.
@@ -131,11 +276,18 @@ void pulse_sensor_process_sample(pulse_sensor_t * PS, uint32_t ms) {
 #ifdef DEBUG_OUTPUT
     LOG("sample: %.6f\n", PS->signal);
 #endif
+    float prev_signal = PS->prev_signal;
+    PS->prev_signal = PS->signal;
+
     PS->sample_counter += ms; // keep track of total time in ms
     PS->N = PS->sample_counter - PS->last_beat_time; // monitor time since last beat to avoid noise
 #ifdef DEBUG_OUTPUT
     LOG("\tsample_counter (%d), last_beat_time (%d)\n", PS->sample_counter, PS->last_beat_time);
 #endif
+    PS->beat_samples++;
+    if(PS->signal <= PULSE_SENSOR_CLIP_LOW || PS->signal >= PULSE_SENSOR_CLIP_HIGH) {
+        PS->clipped_samples++; // ADC at a rail, peak or trough is not real
+    }
 
     // find the peak and trough of the pulse wave
     if(PS->signal < PS->thresh && PS->N > (PS->IBI/5)*3) { // avoid dichrotic noise by waiting 3/5 of last IBI
@@ -155,41 +307,55 @@ void pulse_sensor_process_sample(pulse_sensor_t * PS, uint32_t ms) {
     }
 
     // now look for heart beat, signal surges up everytime there is a pulse
-    if(PS->N > 250) { // avoid high frequency noise
+    if(PS->N > PULSE_REFRACTORY_MS) { // avoid high frequency noise
         if((PS->signal > PS->thresh) && (!PS->pulse) && (PS->N > (PS->IBI/5)*3)) {
             PS->pulse = true; // set the pulse flag when we think there is a pulse
-            PS->IBI = PS->sample_counter - PS->last_beat_time; // measure time in between beats in ms
+            float offset = 0;
+            if(PS->interpolate && prev_signal < PS->thresh) { // crossed thresh between the last two samples
+                offset = ms * (PS->signal - PS->thresh) / (PS->signal - prev_signal); // linear interpolation
+            }
+            // measure time in between beats in ms
+            PS->IBI = (uint32_t)((float)(PS->sample_counter - PS->last_beat_time) + PS->beat_offset - offset + 0.5f);
             PS->last_beat_time = PS->sample_counter; // update last beat time
+            PS->beat_offset = offset;
+            PS->beat_count++;
 #ifdef DEBUG_OUTPUT
             LOG("\t\tBeat found, updated IBI is %d, updated last_beat_time is %d\n", PS->IBI, PS->last_beat_time);
 #endif
+            update_clip_rate(PS);
 
             if(PS->second_beat) {
                 PS->second_beat = false;
-                for(uint8_t i = 0; i < 10; i++) { // seed the running total to get a realistic BPM at startup
+                for(uint8_t i = 0; i < PULSE_RATE_WINDOW; i++) { // seed the running total to get a realistic BPM at startup
                     PS->rate[i] = PS->IBI;
                 }
             }
 
             if(PS->first_beat) {
                 PS->first_beat = false;
-                PS->second_beat = true;
+                PS->second_beat = !PS->warm_start; // a warm start already has a realistic rate array
+                PS->warm_start = false;
                 return; // IBI value is unreliable so discard it
             }
 
-            // keep a running total of the last 10 IBI values
+            // keep a running total of the last PULSE_RATE_WINDOW IBI values
             uint32_t running_total = 0;
 
-            for(uint8_t i = 0; i < 9; i++) { // shift data into the rate array
+            for(uint8_t i = 0; i < PULSE_RATE_WINDOW - 1; i++) { // shift data into the rate array
                 PS->rate[i] = PS->rate[i+1]; // drop the oldest IBI value
-                running_total += PS->rate[i]; // sum the 9 oldest IBI values
+                running_total += PS->rate[i]; // sum the oldest IBI values
             }
 
-            PS->rate[9] = PS->IBI; // add latest IBI to rate array and take running average
+            PS->rate[PULSE_RATE_WINDOW - 1] = PS->IBI; // add latest IBI to rate array and take running average
             running_total += PS->IBI;
-            running_total /= 10;
+            running_total /= PULSE_RATE_WINDOW;
             PS->BPM = 60000 / running_total; // how many beats can fit into a minute?
             PS->start_of_beat = true; // we detected a beat, set start_of_beat flag
+
+            // track IBI variance and reset frequency for the quality index
+            PS->IBI_deviation += (deviation(PS->IBI, PS->IBI_mean) - PS->IBI_deviation) / QUALITY_SHIFT;
+            PS->IBI_mean += ((float)PS->IBI - PS->IBI_mean) / QUALITY_SHIFT;
+            PS->reset_rate -= PS->reset_rate / QUALITY_SHIFT;
         }
     }
 
@@ -201,25 +367,29 @@ void pulse_sensor_process_sample(pulse_sensor_t * PS, uint32_t ms) {
         PS->pulse = false;
         PS->amplitude = PS->peak - PS->trough; // get amplitude of pulse wave
         PS->thresh = PS->amplitude / 2 + PS->trough; // set threshold to 50% of amplitude
+
+        // track amplitude stability for the quality index
+        PS->amplitude_deviation += (deviation(PS->amplitude, PS->amplitude_mean) - PS->amplitude_deviation) / QUALITY_SHIFT;
+        PS->amplitude_mean += (PS->amplitude - PS->amplitude_mean) / QUALITY_SHIFT;
+        update_quality(PS);
         PS->peak = PS->thresh; // reset these for next time
         PS->trough = PS->thresh;
     }
 
-    // if 2.5 seconds go by without a beat
-    if(PS->N > 2500) {
-#ifdef DEBUG_OUTPUT
-    LOG("\tTime since last beat (N = %d) is greater than 2.5 seconds, so reset variables\n", PS->N);
-#endif
-        PS->thresh = PS->thresh_setting;
-        PS->peak = 0.6;
-        PS->trough = 0.6;
-        PS->last_beat_time = PS->sample_counter; // bring last beat time up to date
-        PS->first_beat = true;
-        PS->second_beat = false;
-        PS->start_of_beat = false;
-        PS->BPM = 0;
-        PS->IBI = 600; // 600ms per beat = 100 bpm
-        PS->pulse = false;
-        PS->amplitude = 0.12;
-    }
+    check_reset(PS);
+}
+
+/*
+    @brief lets time pass without a new sample
+    @note only the timing (and the 2.5 second reset) is updated, signal, peak, trough and pulse
+          are left alone, so get_latest_sample() still returns the last real sample
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) that passed without sampling
+    @retval None
+*/
+void pulse_sensor_advance_time(pulse_sensor_t * PS, uint32_t ms) {
+    PS->prev_signal = PS->signal;
+    PS->sample_counter += ms;
+    PS->N = PS->sample_counter - PS->last_beat_time;
+    check_reset(PS);
 }
@@ -25,6 +25,23 @@
 #define LOG(...) NRF_LOG_INFO(__VA_ARGS__) // change to printf when going back to nordic
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef PULSE_RATE_WINDOW
+#define PULSE_RATE_WINDOW 10 // IBI values averaged for BPM
+#endif
+#ifndef PULSE_REFRACTORY_MS
+#define PULSE_REFRACTORY_MS 250 // no beat sooner than this after the last one, avoids high frequency noise
+#endif
+#ifndef PULSE_RESET_MS
+#define PULSE_RESET_MS 2500 // reset if there is no beat for this long
+#endif
+
+#define PULSE_SENSOR_CLIP_LOW 0.01f // samples at or below this are clipped, input range 0-1.2V
+#define PULSE_SENSOR_CLIP_HIGH 1.19f // samples at or above this are clipped
+
 typedef struct {
     // pulse detection output variables
     float signal; // latest voltage signal from ADC, update every time a new sample is ready
@@ -37,7 +54,7 @@ typedef struct {
     uint64_t last_beat_time;
 
     // pulse detection internal variables
-    uint32_t rate[10]; // array to hold last 10 IBI values (ms)
+    uint32_t rate[PULSE_RATE_WINDOW]; // array to hold last PULSE_RATE_WINDOW IBI values (ms)
     uint64_t sample_counter; // determines pulse timing, ms since start
     uint64_t N; // used to monitor duration between beats
     float peak; // peak in pulse wave, (sample value)
@@ -45,6 +62,27 @@ typedef struct {
     float thresh; // instant moment of heart beat, sample value
     bool first_beat; // used to seed rate array so we start with reasonable BPM
     bool second_beat;
+    bool warm_start; // resumed from a snapshot, keep the rate array instead of seeding it
+
+    // beat time interpolation variables
+    bool interpolate; // interpolate beat time between samples, see set_beat_interpolation()
+    float prev_signal; // previous sample, used to find where signal crossed thresh
+    float beat_offset; // time (ms) the interpolated beat came before last_beat_time
+
+    // signal quality output variables
+    uint8_t quality; // signal quality index 0-100, updated every beat and reset
+    uint32_t reset_count; // number of 2.5 second resets since init
+    uint32_t beat_count; // number of beats detected since init, including the discarded first beat
+
+    // signal quality internal variables
+    float amplitude_mean; // running average of amplitude
+    float amplitude_deviation; // running average of |amplitude - amplitude_mean|
+    float IBI_mean; // running average of IBI (ms)
+    float IBI_deviation; // running average of |IBI - IBI_mean| (ms)
+    float reset_rate; // running average of resets per beat, 1 when every beat is a reset
+    float clip_rate; // running average share of samples at the ADC rails
+    uint32_t beat_samples; // samples since the last beat or reset
+    uint32_t clipped_samples; // samples at the ADC rails since the last beat or reset
 }pulse_sensor_t;
 
 /*
@@ -93,12 +131,21 @@ uint8_t get_beats_per_minute(pulse_sensor_t * Pulse_Sensor);
 uint32_t get_inter_beat_interval(pulse_sensor_t * Pulse_Sensor);
 
 /*
-    @brief reads and clears saw start of beat flag
+    @brief returns the saw start of beat flag
+    @note the flag stays set after a beat until take_start_of_beat() or a reset clears it
     @param Pulse Sensor Pointer to pulse sensor handler
     @retval start_of_beat value
 */
 bool saw_start_of_beat(pulse_sensor_t * Pulse_Sensor);
 
+/*
+    @brief reads and clears saw start of beat flag
+    @note reports each beat once, for code that polls after every sample
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval start_of_beat value
+*/
+bool take_start_of_beat(pulse_sensor_t * Pulse_Sensor);
+
 /*
     @brief returns true if the pulse sensor is inside of a heart beat
     @param Pulse Sensor Pointer to pulse sensor handler
@@ -120,6 +167,50 @@ float get_pulse_amplitude(pulse_sensor_t * Pulse_Sensor);
 */
 uint32_t get_last_beat_time(pulse_sensor_t * Pulse_Sensor);
 
+/*
+    @brief turn beat time interpolation on or off
+    @note beat time is normally the first sample above thresh, so IBI resolution is the
+          sample period, with interpolation the thresh crossing between samples is used
+          so lower sample rates give the same IBI precision, off after heart_rate_init()
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param interpolate true to interpolate beat time
+    @retval None
+*/
+void set_beat_interpolation(pulse_sensor_t * Pulse_Sensor, bool interpolate);
+
+/*
+    @brief returns how long before last_beat_time the interpolated beat happened
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval beat_offset value (ms), 0 without interpolation
+*/
+float get_beat_offset(pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief get the signal quality index
+    @note combines amplitude stability, IBI variance, reset frequency, clipping and peak/trough ratio,
+          use it to suppress or slow down outputs when the signal is bad
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval quality value, 0 (garbage) to 100 (clean)
+*/
+uint8_t get_signal_quality(pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief get the number of 2.5 second resets since init
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval reset_count value
+*/
+uint32_t get_reset_count(pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief get the number of beats detected since init
+    @note counts every thresh crossing taken as a beat, including the first one after a reset
+          whose IBI is discarded, last_beat_time also moves on resets, resumes and seeding so
+          watch this instead to find beats
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval beat_count value
+*/
+uint32_t get_beat_count(pulse_sensor_t * Pulse_Sensor);
+
 /*
     @brief processes the latest sample value
     @note calculates BPM, IBI, etc.
@@ -128,4 +219,18 @@ uint32_t get_last_beat_time(pulse_sensor_t * Pulse_Sensor);
 */
 void pulse_sensor_process_sample(pulse_sensor_t * Pulse_Sensor, uint32_t ms);
 
+/*
+    @brief lets time pass without a new sample
+    @note only the timing (and the 2.5 second reset) is updated, signal, peak, trough and pulse
+          are left alone, so get_latest_sample() still returns the last real sample
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) that passed without sampling
+    @retval None
+*/
+void pulse_sensor_advance_time(pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // HEART_RATE_H
\ No newline at end of file
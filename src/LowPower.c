@@ -0,0 +1,175 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Low Power Mode
+
+  @File Name
+    LowPower.c
+
+  @Summary
+    Event driven pulse detection using an analog comparator wake-up
+
+  @Description
+    Implements functions that let the micro sleep between heart beats, the
+    comparator is programmed with the current thresh and only crossings
+    (plus a short ADC burst around them) are processed
+******************************************************************************/
+
+#include "LowPower.h"
+#include <float.h>
+
+static void arm_comparator(low_power_t * LP) {
+    LP->comparator.arm(LP->comparator.ctx, LP->PS->thresh, LP->hysteresis);
+    LP->state = LOW_POWER_ARMED;
+}
+
+static uint32_t refractory_time(low_power_t * LP) {
+    uint64_t refractory = (LP->PS->IBI/5)*3; // same dichrotic window used by pulse_sensor_process_sample
+    if(refractory < PULSE_REFRACTORY_MS) {
+        refractory = PULSE_REFRACTORY_MS;
+    }
+    return refractory > LP->PS->N ? refractory - LP->PS->N : 0;
+}
+
+/*
+    @brief low power mode initialization
+    @note heart_rate_init() must be called on the pulse sensor first, the comparator is armed right away
+    @param Low Power Pointer to low power handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param comparator comparator interface
+    @param hysteresis comparator hysteresis, sample value
+    @param burst_ms minimum time (ms) to sample the ADC after each crossing
+    @retval None
+*/
+void low_power_init(low_power_t * LP, pulse_sensor_t * PS, comparator_t comparator, float hysteresis, uint32_t burst_ms) {
+    LP->PS = PS;
+    LP->comparator = comparator;
+    LP->hysteresis = hysteresis;
+    LP->burst_ms = burst_ms;
+    LP->burst_elapsed = 0;
+    LP->burst_min = FLT_MAX;
+    arm_comparator(LP);
+}
+
+/*
+    @brief how long the micro may sleep before calling low_power_on_timer()
+    @note the comparator may still wake the micro earlier while armed
+    @param Low Power Pointer to low power handler
+    @retval sleep time (ms), 0 while bursting
+*/
+uint32_t low_power_sleep_time(low_power_t * LP) {
+    switch(LP->state) {
+        case LOW_POWER_REFRACTORY:
+            return refractory_time(LP);
+        case LOW_POWER_ARMED:
+            // wake up just after 2.5 seconds so the reset can happen
+            return LP->PS->N > PULSE_RESET_MS ? 0 : PULSE_RESET_MS + 1 - LP->PS->N;
+        default:
+            return 0;
+    }
+}
+
+/*
+    @brief handles a timer wake-up
+    @note arms the comparator once the refractory window is over and keeps the 2.5 second reset working
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last low power call
+    @retval None
+*/
+void low_power_on_timer(low_power_t * LP, uint32_t ms) {
+    pulse_sensor_advance_time(LP->PS, ms);
+
+    if(LP->state == LOW_POWER_REFRACTORY && refractory_time(LP) == 0) {
+        arm_comparator(LP);
+    }
+    else if(LP->state == LOW_POWER_ARMED) {
+        arm_comparator(LP); // thresh goes back to thresh_setting after a reset
+    }
+}
+
+/*
+    @brief handles a comparator wake-up
+    @note put the ADC sample taken at the crossing in signal before calling, starts an ADC burst
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last low power call
+    @retval None
+*/
+void low_power_on_crossing(low_power_t * LP, uint32_t ms) {
+    LP->comparator.disarm(LP->comparator.ctx);
+    LP->state = LOW_POWER_BURST;
+    LP->burst_elapsed = 0;
+    LP->burst_min = FLT_MAX;
+    pulse_sensor_process_sample(LP->PS, ms);
+}
+
+/*
+    @brief processes a sample of the ADC burst
+    @note put the ADC sample in signal before calling, refines peak and trough
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last sample
+    @retval true while the burst should continue, false when the micro can go back to sleep
+*/
+bool low_power_process_burst_sample(low_power_t * LP, uint32_t ms) {
+    pulse_sensor_t * PS = LP->PS;
+
+    pulse_sensor_process_sample(PS, ms);
+    LP->burst_elapsed += ms;
+
+    if(!PS->pulse && PS->signal < LP->burst_min) {
+        LP->burst_min = PS->signal; // trough is only tracked late in the IBI, which we sleep through
+    }
+
+    if(PS->pulse || LP->burst_elapsed < LP->burst_ms) {
+        return true;
+    }
+
+    if(LP->burst_min < PS->trough) {
+        PS->trough = LP->burst_min; // used for amplitude and thresh when the next beat is over
+    }
+    LP->state = LOW_POWER_REFRACTORY;
+    return false;
+}
+
+static void soft_comparator_arm(void * ctx, float level, float hysteresis) {
+    soft_comparator_t * SC = ctx;
+    SC->level = level;
+    SC->hysteresis = hysteresis;
+    SC->armed = true;
+    SC->output = false; // fire right away if the signal is already above level
+}
+
+static void soft_comparator_disarm(void * ctx) {
+    soft_comparator_t * SC = ctx;
+    SC->armed = false;
+}
+
+/*
+    @brief get comparator interface for a software comparator
+    @note software stand-in for an analog comparator, used for testing without the hardware
+    @param Soft Comparator Pointer to software comparator
+    @retval comparator interface
+*/
+comparator_t soft_comparator_interface(soft_comparator_t * SC) {
+    comparator_t comparator = {soft_comparator_arm, soft_comparator_disarm, SC};
+    SC->armed = false;
+    SC->output = false;
+    return comparator;
+}
+
+/*
+    @brief feeds a sample to the software comparator
+    @param Soft Comparator Pointer to software comparator
+    @param sample latest sample value
+    @retval true if the comparator would wake the micro
+*/
+bool soft_comparator_input(soft_comparator_t * SC, float sample) {
+    bool rising = false;
+
+    if(!SC->output && sample > SC->level) {
+        SC->output = true;
+        rising = true;
+    }
+    else if(SC->output && sample < SC->level - SC->hysteresis) {
+        SC->output = false;
+    }
+
+    return rising && SC->armed;
+}
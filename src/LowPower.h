@@ -0,0 +1,121 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Low Power Mode
+
+  @File Name
+    LowPower.h
+
+  @Summary
+    Event driven pulse detection using an analog comparator wake-up
+
+  @Description
+    Defines functions that let the micro sleep between heart beats, the
+    comparator is programmed with the current thresh and only crossings
+    (plus a short ADC burst around them) are processed
+******************************************************************************/
+
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    void (*arm)(void * ctx, float level, float hysteresis); // wake on signal rising above level
+    void (*disarm)(void * ctx); // stop generating wake-up events
+    void * ctx; // passed back to arm and disarm, e.g. comparator peripheral handle
+}comparator_t;
+
+typedef enum {
+    LOW_POWER_REFRACTORY, // sleeping, too soon after the last beat for a new one
+    LOW_POWER_ARMED, // sleeping, comparator armed at thresh
+    LOW_POWER_BURST // sampling the ADC around a crossing
+}low_power_state_t;
+
+typedef struct {
+    pulse_sensor_t * PS; // pulse sensor the events are fed to
+    comparator_t comparator;
+    float hysteresis; // comparator hysteresis, sample value
+    uint32_t burst_ms; // minimum time (ms) to sample after a crossing
+    uint32_t burst_elapsed; // time (ms) sampled in the current burst
+    float burst_min; // lowest sample seen after the beat was over
+    low_power_state_t state;
+}low_power_t;
+
+typedef struct {
+    float level;
+    float hysteresis;
+    bool armed;
+    bool output; // high while signal is above level, low once it drops below level - hysteresis
+}soft_comparator_t;
+
+/*
+    @brief low power mode initialization
+    @note heart_rate_init() must be called on the pulse sensor first, the comparator is armed right away
+    @param Low Power Pointer to low power handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param comparator comparator interface
+    @param hysteresis comparator hysteresis, sample value
+    @param burst_ms minimum time (ms) to sample the ADC after each crossing
+    @retval None
+*/
+void low_power_init(low_power_t * Low_Power, pulse_sensor_t * Pulse_Sensor, comparator_t comparator, float hysteresis, uint32_t burst_ms);
+
+/*
+    @brief how long the micro may sleep before calling low_power_on_timer()
+    @note the comparator may still wake the micro earlier while armed
+    @param Low Power Pointer to low power handler
+    @retval sleep time (ms), 0 while bursting
+*/
+uint32_t low_power_sleep_time(low_power_t * Low_Power);
+
+/*
+    @brief handles a timer wake-up
+    @note arms the comparator once the refractory window is over and keeps the 2.5 second reset working
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last low power call
+    @retval None
+*/
+void low_power_on_timer(low_power_t * Low_Power, uint32_t ms);
+
+/*
+    @brief handles a comparator wake-up
+    @note put the ADC sample taken at the crossing in signal before calling, starts an ADC burst
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last low power call
+    @retval None
+*/
+void low_power_on_crossing(low_power_t * Low_Power, uint32_t ms);
+
+/*
+    @brief processes a sample of the ADC burst
+    @note put the ADC sample in signal before calling, refines peak and trough
+    @param Low Power Pointer to low power handler
+    @param ms time (ms) since the last sample
+    @retval true while the burst should continue, false when the micro can go back to sleep
+*/
+bool low_power_process_burst_sample(low_power_t * Low_Power, uint32_t ms);
+
+/*
+    @brief get comparator interface for a software comparator
+    @note software stand-in for an analog comparator, used for testing without the hardware
+    @param Soft Comparator Pointer to software comparator
+    @retval comparator interface
+*/
+comparator_t soft_comparator_interface(soft_comparator_t * Soft_Comparator);
+
+/*
+    @brief feeds a sample to the software comparator
+    @param Soft Comparator Pointer to software comparator
+    @param sample latest sample value
+    @retval true if the comparator would wake the micro
+*/
+bool soft_comparator_input(soft_comparator_t * Soft_Comparator, float sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOW_POWER_H
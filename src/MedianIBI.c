@@ -0,0 +1,213 @@
+/* ****************************************************************************/
+/** Median Inter Beat Interval
+
+  @File Name
+    MedianIBI.c
+
+  @Summary
+    Calculates BPM from a sliding median of IBI values with outlier rejection
+
+  @Description
+    Implements functions for an optional IBI estimator where a missed or double
+    counted beat does not skew BPM, a pair of indexed heaps keeps the median
+    in O(log n) per beat and a Hampel test rejects (and counts) outliers
+******************************************************************************/
+
+#include "MedianIBI.h"
+
+/*
+    The window is kept in one array of heap slots centered on the median:
+    slot 0 is the median, slots 1..n are a min-heap of the values above it and
+    slots -1..-n are a max-heap of the values below it. pos[] maps each ring
+    index to its slot so the value leaving the window can be replaced in place.
+*/
+#define HEAP(m, i) ((m)->heap[(i) + MEDIAN_IBI_WINDOW/2])
+#define MIN_COUNT(m) (((m)->count - 1) / 2) // values in the min-heap
+#define MAX_COUNT(m) ((m)->count / 2) // values in the max-heap
+#define MAD_SCALE 1.4826f // MAD to standard deviation for normally distributed IBIs
+
+static bool less(median_heap_t * m, int i, int j) {
+    return m->data[HEAP(m, i)] < m->data[HEAP(m, j)];
+}
+
+static bool exchange(median_heap_t * m, int i, int j) {
+    int8_t t = HEAP(m, i);
+    HEAP(m, i) = HEAP(m, j);
+    HEAP(m, j) = t;
+    m->pos[HEAP(m, i)] = i;
+    m->pos[HEAP(m, j)] = j;
+    return true;
+}
+
+static bool compare_exchange(median_heap_t * m, int i, int j) {
+    return less(m, i, j) && exchange(m, i, j);
+}
+
+static void min_sort_down(median_heap_t * m, int i) { // restores the min-heap from slot i down
+    for(; i <= MIN_COUNT(m); i *= 2) {
+        if(i > 1 && i < MIN_COUNT(m) && less(m, i+1, i)) {
+            i++; // pick the smaller child
+        }
+        if(!compare_exchange(m, i, i/2)) {
+            break;
+        }
+    }
+}
+
+static void max_sort_down(median_heap_t * m, int i) { // restores the max-heap from slot i down
+    for(; i >= -MAX_COUNT(m); i *= 2) {
+        if(i < -1 && i > -MAX_COUNT(m) && less(m, i, i-1)) {
+            i--; // pick the larger child
+        }
+        if(!compare_exchange(m, i/2, i)) {
+            break;
+        }
+    }
+}
+
+static bool min_sort_up(median_heap_t * m, int i) {
+    while(i > 0 && compare_exchange(m, i, i/2)) {
+        i /= 2;
+    }
+    return i == 0; // reached the median slot
+}
+
+static bool max_sort_up(median_heap_t * m, int i) {
+    while(i < 0 && compare_exchange(m, i/2, i)) {
+        i /= 2;
+    }
+    return i == 0; // reached the median slot
+}
+
+static void heap_init(median_heap_t * m) {
+    m->idx = 0;
+    m->count = 0;
+    for(int i = MEDIAN_IBI_WINDOW - 1; i >= 0; i--) { // fill pattern: median, max, min, max, ...
+        m->pos[i] = ((i+1)/2) * ((i & 1) ? -1 : 1);
+        m->data[i] = 0;
+        HEAP(m, m->pos[i]) = i;
+    }
+}
+
+static void heap_insert(median_heap_t * m, uint32_t v) {
+    bool is_new = m->count < MEDIAN_IBI_WINDOW;
+    int p = m->pos[m->idx];
+    uint32_t old = m->data[m->idx];
+
+    m->data[m->idx] = v; // overwrite the oldest value
+    m->idx = (m->idx + 1) % MEDIAN_IBI_WINDOW;
+    m->count += is_new;
+
+    if(p > 0) { // slot is in the min-heap
+        if(!is_new && old < v) {
+            min_sort_down(m, p*2);
+        }
+        else if(min_sort_up(m, p)) {
+            max_sort_down(m, -1);
+        }
+    }
+    else if(p < 0) { // slot is in the max-heap
+        if(!is_new && v < old) {
+            max_sort_down(m, p*2);
+        }
+        else if(max_sort_up(m, p)) {
+            min_sort_down(m, 1);
+        }
+    }
+    else { // slot is the median
+        if(MAX_COUNT(m)) {
+            max_sort_down(m, -1);
+        }
+        if(MIN_COUNT(m)) {
+            min_sort_down(m, 1);
+        }
+    }
+}
+
+static uint32_t heap_median(median_heap_t * m) {
+    uint32_t v = m->data[HEAP(m, 0)];
+    if(m->count > 0 && (m->count & 1) == 0) {
+        v = (v + m->data[HEAP(m, -1)]) / 2; // even count, average the two middle values
+    }
+    return v;
+}
+
+/*
+    @brief median ibi initialization
+    @param Median Pointer to median ibi handler
+    @retval None
+*/
+void median_ibi_init(median_ibi_t * M) {
+    heap_init(&M->ibi);
+    heap_init(&M->deviation);
+    M->IBI = 0;
+    M->BPM = 0;
+    M->rejected = 0;
+    M->consecutive_rejects = 0;
+}
+
+/*
+    @brief add a beat
+    @note call once per beat, e.g. when take_start_of_beat() returns true
+    @param Median Pointer to median ibi handler
+    @param ibi inter beat interval of the beat (ms)
+    @retval true if the beat was accepted, false if it was rejected as an outlier
+*/
+bool median_ibi_add_beat(median_ibi_t * M, uint32_t ibi) {
+    if(ibi == 0) {
+        return false;
+    }
+
+    uint32_t deviation = ibi > M->IBI ? ibi - M->IBI : M->IBI - ibi;
+
+    // Hampel test against the current median and MAD
+    if(M->ibi.count >= MEDIAN_IBI_WARMUP) {
+        float limit = MEDIAN_IBI_HAMPEL_K * MAD_SCALE * heap_median(&M->deviation);
+        if(limit < MEDIAN_IBI_MIN_DEVIATION) {
+            limit = MEDIAN_IBI_MIN_DEVIATION;
+        }
+        if(deviation <= limit) {
+            M->consecutive_rejects = 0; // in rhythm with the median, also ends a rhythm change
+        }
+        else if(M->consecutive_rejects < MEDIAN_IBI_MAX_REJECTS) {
+            M->rejected++;
+            M->consecutive_rejects++;
+            return false;
+        }
+        // else the rhythm changed, keep accepting until the median has moved to it
+    }
+    heap_insert(&M->ibi, ibi);
+    if(M->ibi.count > 1) {
+        heap_insert(&M->deviation, deviation);
+    }
+    M->IBI = heap_median(&M->ibi);
+    M->BPM = 60000 / M->IBI;
+    return true;
+}
+
+/*
+    @brief get the median inter-beat interval
+    @param Median Pointer to median ibi handler
+    @retval IBI value, 0 before the first beat
+*/
+uint32_t get_median_inter_beat_interval(median_ibi_t * M) {
+    return M->IBI;
+}
+
+/*
+    @brief get the bpm from the median inter-beat interval
+    @param Median Pointer to median ibi handler
+    @retval BPM value
+*/
+uint8_t get_median_beats_per_minute(median_ibi_t * M) {
+    return M->BPM;
+}
+
+/*
+    @brief get number of beats rejected as outliers
+    @param Median Pointer to median ibi handler
+    @retval rejected count
+*/
+uint32_t get_rejected_beats(median_ibi_t * M) {
+    return M->rejected;
+}
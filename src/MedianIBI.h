@@ -0,0 +1,93 @@
+/* ****************************************************************************/
+/** Median Inter Beat Interval
+
+  @File Name
+    MedianIBI.h
+
+  @Summary
+    Calculates BPM from a sliding median of IBI values with outlier rejection
+
+  @Description
+    Defines functions for an optional IBI estimator where a missed or double
+    counted beat does not skew BPM, a pair of indexed heaps keeps the median
+    in O(log n) per beat and a Hampel test rejects (and counts) outliers
+******************************************************************************/
+
+#ifndef MEDIAN_IBI_H
+#define MEDIAN_IBI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIAN_IBI_WINDOW 15 // IBI values in the median window
+#define MEDIAN_IBI_WARMUP 5 // beats accepted without an outlier test
+#define MEDIAN_IBI_HAMPEL_K 3.0f // outlier if further than K scaled MADs from the median
+#define MEDIAN_IBI_MIN_DEVIATION 20 // ms, allowed deviation when MAD is (close to) 0
+#define MEDIAN_IBI_MAX_REJECTS (MEDIAN_IBI_WINDOW / 2) // after this many rejects in a row the rhythm changed, accept until the median follows
+
+typedef struct {
+    uint32_t data[MEDIAN_IBI_WINDOW]; // ring buffer of values
+    int8_t pos[MEDIAN_IBI_WINDOW]; // heap position of each value
+    int8_t heap[MEDIAN_IBI_WINDOW]; // index of value at each heap position, offset by MEDIAN_IBI_WINDOW/2
+    uint8_t idx; // next ring index to overwrite
+    uint8_t count; // values in the window
+}median_heap_t;
+
+typedef struct {
+    // median output variables
+    uint32_t IBI; // median inter beat interval (ms)
+    uint8_t BPM; // beats per minute from the median IBI
+    uint32_t rejected; // number of beats rejected as outliers
+
+    // median internal variables
+    median_heap_t ibi; // accepted IBI values
+    median_heap_t deviation; // absolute deviation from the median of each accepted IBI, median is the MAD
+    uint8_t consecutive_rejects;
+}median_ibi_t;
+
+/*
+    @brief median ibi initialization
+    @param Median Pointer to median ibi handler
+    @retval None
+*/
+void median_ibi_init(median_ibi_t * Median);
+
+/*
+    @brief add a beat
+    @note call once per beat, e.g. when take_start_of_beat() returns true
+    @param Median Pointer to median ibi handler
+    @param ibi inter beat interval of the beat (ms)
+    @retval true if the beat was accepted, false if it was rejected as an outlier
+*/
+bool median_ibi_add_beat(median_ibi_t * Median, uint32_t ibi);
+
+/*
+    @brief get the median inter-beat interval
+    @param Median Pointer to median ibi handler
+    @retval IBI value, 0 before the first beat
+*/
+uint32_t get_median_inter_beat_interval(median_ibi_t * Median);
+
+/*
+    @brief get the bpm from the median inter-beat interval
+    @param Median Pointer to median ibi handler
+    @retval BPM value
+*/
+uint8_t get_median_beats_per_minute(median_ibi_t * Median);
+
+/*
+    @brief get number of beats rejected as outliers
+    @param Median Pointer to median ibi handler
+    @retval rejected count
+*/
+uint32_t get_rejected_beats(median_ibi_t * Median);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIAN_IBI_H
@@ -0,0 +1,195 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Pulse Morphology
+
+  @File Name
+    Morphology.c
+
+  @Summary
+    Per beat pulse shape features computed while samples stream in
+
+  @Description
+    Implements the pulse follower. The lowest sample since the last peak is
+    the candidate foot of the next pulse, when the pulse sensor detects a
+    beat the candidate becomes the foot and the previous pulse is complete.
+******************************************************************************/
+
+#include "Morphology.h"
+
+static void edge_reset(morphology_t * M) {
+    M->edge_head = 0;
+    M->edge_count = 0;
+}
+
+static void edge_push(morphology_t * M, float signal, uint32_t time) {
+    M->edge[M->edge_head] = signal;
+    M->edge_time[M->edge_head] = time;
+    M->edge_head = (M->edge_head + 1) % MORPHOLOGY_EDGE_SAMPLES;
+    if(M->edge_count < MORPHOLOGY_EDGE_SAMPLES) {
+        M->edge_count++;
+    }
+}
+
+// new candidate foot, the edge ring starts over from it
+static void start_minimum(morphology_t * M, float signal, uint64_t time) {
+    M->minimum = signal;
+    M->minimum_time = time;
+    M->area_at_minimum = M->area;
+    edge_reset(M);
+    edge_push(M, signal, 0);
+}
+
+// first rising crossing of level in the edge ring, time (ms) after the foot, 0 if it is not in the ring
+static float find_rise_cross(morphology_t * M) {
+    uint8_t oldest = (M->edge_head + MORPHOLOGY_EDGE_SAMPLES - M->edge_count) % MORPHOLOGY_EDGE_SAMPLES;
+    for(uint8_t i = 1; i < M->edge_count; i++) {
+        uint8_t a = (oldest + i - 1) % MORPHOLOGY_EDGE_SAMPLES;
+        uint8_t b = (oldest + i) % MORPHOLOGY_EDGE_SAMPLES;
+        if(M->edge[a] < M->level && M->edge[b] >= M->level) {
+            float fraction = (M->level - M->edge[a]) / (M->edge[b] - M->edge[a]);
+            return M->edge_time[a] + fraction * (float)(M->edge_time[b] - M->edge_time[a]);
+        }
+    }
+    return 0;
+}
+
+static void finish_pulse(morphology_t * M) {
+    morphology_features_t * f = &M->features;
+    *f = M->pulse;
+    f->amplitude = M->peak - M->foot;
+    f->rise_time = (float)(M->peak_time - M->pulse.foot_time);
+    f->width = (M->rise_cross > 0 && M->fall_cross > 0) ? M->fall_cross - M->rise_cross : 0;
+    f->area = M->area_at_minimum - M->foot * (float)(M->minimum_time - M->pulse.foot_time);
+    // a notch is a turn on the way down, if the first turn was the next upstroke there was none
+    f->notch_time = (M->notch_found && M->notch_time < M->minimum_time) ? (float)(M->notch_time - M->pulse.foot_time) : 0;
+    M->ready = true;
+}
+
+/*
+    @brief morphology stage initialization
+    @param Morphology Pointer to morphology handler
+    @retval None
+*/
+void morphology_init(morphology_t * M) {
+    M->ready = false;
+    M->phase = MORPHOLOGY_SEARCH;
+    M->area = 0;
+    M->seeded = false;
+    M->notch_found = false;
+    M->beat_count = 0;
+    M->reset_count = 0;
+    edge_reset(M);
+}
+
+/*
+    @brief follows the pulse shape with the latest sample
+    @note call right after pulse_sensor_process_sample(), reads signal, beats and resets from the pulse sensor
+    @param Morphology Pointer to morphology handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void morphology_process_sample(morphology_t * M, pulse_sensor_t * PS) {
+    float s = PS->signal;
+    uint64_t t = PS->sample_counter;
+    bool beat = PS->beat_count != M->beat_count;
+    M->beat_count = PS->beat_count;
+
+    if(!M->seeded || PS->reset_count != M->reset_count) {
+        // start over, the pulse was lost
+        M->reset_count = PS->reset_count;
+        M->phase = MORPHOLOGY_SEARCH;
+        M->area = 0;
+        M->seeded = true;
+        start_minimum(M, s, t);
+        M->prev_signal = s;
+        M->prev_time = t;
+        return;
+    }
+
+    M->area += (s + M->prev_signal) * 0.5f * (float)(t - M->prev_time);
+
+    if(beat) {
+        if(M->phase == MORPHOLOGY_FALLING) {
+            finish_pulse(M);
+        }
+        // the candidate foot is the foot of the new pulse
+        M->foot = M->minimum;
+        M->pulse.foot_time = M->minimum_time;
+        M->area -= M->area_at_minimum;
+        M->peak = s;
+        M->peak_time = t;
+        M->rise_cross = 0;
+        M->fall_cross = 0;
+        M->notch_found = false;
+        M->phase = MORPHOLOGY_RISING;
+    }
+
+    float rebound = PS->amplitude;
+    if(M->phase == MORPHOLOGY_RISING && M->peak - M->foot > rebound) {
+        rebound = M->peak - M->foot;
+    }
+    rebound *= MORPHOLOGY_REBOUND;
+
+    switch(M->phase) {
+        case MORPHOLOGY_RISING:
+            edge_push(M, s, (uint32_t)(t - M->pulse.foot_time));
+            if(s > M->peak) {
+                M->peak = s;
+                M->peak_time = t;
+            }
+            else if(s < M->peak - rebound || !PS->pulse) {
+                // peak confirmed
+                M->level = M->foot + (M->peak - M->foot) * 0.5f;
+                M->rise_cross = find_rise_cross(M);
+                M->phase = MORPHOLOGY_FALLING;
+                start_minimum(M, s, t);
+            }
+            if(M->phase == MORPHOLOGY_RISING) {
+                break;
+            }
+            // the sample that confirmed the peak may already be below level
+            // fall through
+        case MORPHOLOGY_FALLING:
+            if(M->fall_cross == 0 && M->prev_signal >= M->level && s < M->level) {
+                float fraction = (M->prev_signal - M->level) / (M->prev_signal - s);
+                M->fall_cross = (float)(M->prev_time - M->pulse.foot_time) + fraction * (float)(t - M->prev_time);
+            }
+            if(s <= M->minimum) {
+                start_minimum(M, s, t);
+            }
+            else {
+                edge_push(M, s, (uint32_t)(t - M->minimum_time));
+                if(!M->notch_found && s > M->minimum + rebound) {
+                    M->notch_found = true;
+                    M->notch_time = M->minimum_time;
+                }
+            }
+            break;
+        case MORPHOLOGY_SEARCH:
+            if(s <= M->minimum) {
+                start_minimum(M, s, t);
+            }
+            else {
+                edge_push(M, s, (uint32_t)(t - M->minimum_time));
+            }
+            break;
+    }
+
+    M->prev_signal = s;
+    M->prev_time = t;
+}
+
+/*
+    @brief reads and clears the features of the last complete pulse
+    @note a pulse is complete when the next beat starts, so this is ready once per beat
+    @param Morphology Pointer to morphology handler
+    @param features set to the features if they are ready
+    @retval true if new features were ready
+*/
+bool morphology_get_features(morphology_t * M, morphology_features_t * features) {
+    if(!M->ready) {
+        return false;
+    }
+    *features = M->features;
+    M->ready = false;
+    return true;
+}
@@ -0,0 +1,105 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Pulse Morphology
+
+  @File Name
+    Morphology.h
+
+  @Summary
+    Per beat pulse shape features computed while samples stream in
+
+  @Description
+    Defines functions for a stage next to pulse_sensor_process_sample() that
+    follows each pulse from its foot (the minimum before the upstroke) to the
+    next foot and measures rise time, width at 50% amplitude, area and
+    dicrotic notch timing. Only the rising edge is buffered, in a bounded
+    ring, to find the 50% crossing once the peak is known.
+******************************************************************************/
+
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MORPHOLOGY_EDGE_SAMPLES 128 // rising edge ring, covers 256 ms at 500 Hz
+#define MORPHOLOGY_REBOUND 0.05f // share of amplitude the signal must turn by to count as a peak or notch
+
+typedef struct {
+    uint64_t foot_time; // time (ms) of the pulse foot, as sample_counter
+    float amplitude; // peak - foot (sample value)
+    float rise_time; // foot to peak (ms)
+    float width; // time above 50% amplitude (ms), 0 if a crossing was not seen
+    float area; // area above the foot from foot to the next foot (sample value * ms)
+    float notch_time; // foot to dicrotic notch (ms), 0 if no notch was seen
+}morphology_features_t;
+
+typedef enum {
+    MORPHOLOGY_SEARCH, // no foot yet, after init or reset
+    MORPHOLOGY_RISING, // foot found, looking for the peak
+    MORPHOLOGY_FALLING // after the peak, looking for the notch and the next foot
+}morphology_phase_t;
+
+typedef struct {
+    // morphology output variables
+    morphology_features_t features; // features of the last complete pulse
+    bool ready; // features were updated and not read yet
+
+    // morphology internal variables
+    morphology_phase_t phase;
+    morphology_features_t pulse; // pulse being measured
+    float foot; // foot value of the pulse being measured
+    float peak;
+    uint64_t peak_time;
+    float level; // 50% amplitude level of the pulse being measured
+    float rise_cross; // time (ms) after the foot the signal rose through level, 0 if not found
+    float fall_cross; // time (ms) after the foot the signal fell through level, 0 if not found yet
+    float minimum; // lowest sample since the peak, candidate foot of the next pulse
+    uint64_t minimum_time;
+    float area_at_minimum; // area when minimum was seen
+    bool notch_found;
+    uint64_t notch_time;
+    float area; // integral of signal since the foot (sample value * ms)
+    float prev_signal;
+    uint64_t prev_time;
+    bool seeded; // prev_signal and minimum hold a sample
+    float edge[MORPHOLOGY_EDGE_SAMPLES]; // samples since the candidate foot
+    uint32_t edge_time[MORPHOLOGY_EDGE_SAMPLES]; // their time (ms) after the candidate foot
+    uint8_t edge_head; // next index to write
+    uint8_t edge_count;
+    uint32_t beat_count; // beat_count seen, a change is a beat
+    uint32_t reset_count; // reset_count seen, a change is a reset
+}morphology_t;
+
+/*
+    @brief morphology stage initialization
+    @param Morphology Pointer to morphology handler
+    @retval None
+*/
+void morphology_init(morphology_t * Morphology);
+
+/*
+    @brief follows the pulse shape with the latest sample
+    @note call right after pulse_sensor_process_sample(), reads signal, beats and resets from the pulse sensor
+    @param Morphology Pointer to morphology handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void morphology_process_sample(morphology_t * Morphology, pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief reads and clears the features of the last complete pulse
+    @note a pulse is complete when the next beat starts, so this is ready once per beat
+    @param Morphology Pointer to morphology handler
+    @param features set to the features if they are ready
+    @retval true if new features were ready
+*/
+bool morphology_get_features(morphology_t * Morphology, morphology_features_t * features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MORPHOLOGY_H
@@ -0,0 +1,238 @@
+/* ****************************************************************************/
+/** Motion Artifact Rejection
+
+  @File Name
+    Motion.c
+
+  @Summary
+    Removes motion artifacts using a synchronized 3-axis accelerometer
+
+  @Description
+    Implements functions for an optional stage in front of pulse_sensor_process_sample(),
+    an NLMS adaptive filter cancels the part of the signal that follows the
+    accelerometer and beats are not accepted while motion energy is high.
+    Float and fixed point (Q15) variants are provided, both with a block call
+    that loops over the per sample call.
+******************************************************************************/
+
+#include "Motion.h"
+#include <string.h>
+
+#define MOTION_EPSILON 1e-6f // keeps the NLMS normalization finite when the accelerometer is still
+
+// passes the filtered sample to the pulse sensor
+static void pass_to_sensor(pulse_sensor_t * PS, bool gated, uint32_t ms) {
+    if(gated) {
+        pulse_sensor_advance_time(PS, ms); // keeps the filtered sample in signal, motion would push it over thresh
+    }
+    else {
+        pulse_sensor_process_sample(PS, ms);
+    }
+}
+
+/*
+    @brief motion stage initialization
+    @param Motion Pointer to motion handler
+    @param mu NLMS step size, 0-1 (0.05 is a good start)
+    @param gate_energy motion energy above which beats are not accepted (accelerometer units^2)
+    @retval None
+*/
+void motion_init(motion_t * M, float mu, float gate_energy) {
+    memset(M, 0, sizeof(*M));
+    M->mu = mu;
+    M->gate_energy = gate_energy;
+}
+
+/*
+    @brief filters the latest sample and passes it to the pulse sensor
+    @note put the raw ADC sample in signal before calling, signal is replaced by the filtered sample
+          and pulse_sensor_process_sample() is called, while gated signal keeps the filtered sample
+          and only time passes, so no peak, trough or beat comes from motion
+    @param Motion Pointer to motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param accel accelerometer sample taken with the ADC sample (x, y, z)
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void motion_process_sample(motion_t * M, pulse_sensor_t * PS, const float accel[MOTION_AXES], uint32_t ms) {
+    if(!M->seeded) {
+        M->seeded = true;
+        M->signal_baseline = PS->signal;
+        for(uint8_t a = 0; a < MOTION_AXES; a++) {
+            M->accel_baseline[a] = accel[a];
+        }
+    }
+
+    // remove gravity and shift the accelerometer into the delay line
+    float accel_energy = 0;
+    for(uint8_t a = 0; a < MOTION_AXES; a++) {
+        float x = accel[a] - M->accel_baseline[a];
+        M->accel_baseline[a] += x / (1 << MOTION_BASELINE_SHIFT);
+        accel_energy += x * x;
+
+        float * line = &M->reference[a * MOTION_TAPS];
+        for(uint8_t t = MOTION_TAPS - 1; t > 0; t--) {
+            line[t] = line[t-1];
+        }
+        line[0] = x;
+    }
+    M->energy += (accel_energy - M->energy) / (1 << MOTION_ENERGY_SHIFT);
+    M->gated = M->energy > M->gate_energy;
+
+    // NLMS: subtract the part of the signal predicted from the accelerometer
+    float d = PS->signal - M->signal_baseline;
+    M->signal_baseline += d / (1 << MOTION_BASELINE_SHIFT);
+
+    float y = 0;
+    float power = MOTION_EPSILON;
+    for(uint8_t i = 0; i < MOTION_WEIGHTS; i++) {
+        y += M->weights[i] * M->reference[i];
+        power += M->reference[i] * M->reference[i];
+    }
+
+    float e = d - y;
+    float step = M->mu * e / power;
+    for(uint8_t i = 0; i < MOTION_WEIGHTS; i++) {
+        M->weights[i] += step * M->reference[i];
+    }
+
+    PS->signal = M->signal_baseline + e; // thresh, peak and trough stay in sample units
+    pass_to_sensor(PS, M->gated, ms);
+}
+
+/*
+    @brief filters a block of samples and passes them to the pulse sensor
+    @note a plain loop over motion_process_sample(), for samples that arrive in DMA buffers
+    @param Motion Pointer to motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param samples raw ADC samples
+    @param accel accelerometer samples, one per ADC sample
+    @param count number of samples
+    @param ms time (ms) between samples
+    @retval number of beats detected in the block
+*/
+uint16_t motion_process_block(motion_t * M, pulse_sensor_t * PS, const float * samples, const float (*accel)[MOTION_AXES], uint16_t count, uint32_t ms) {
+    uint16_t beats = 0;
+
+    for(uint16_t i = 0; i < count; i++) {
+        bool was_inside_beat = PS->pulse;
+        PS->signal = samples[i];
+        motion_process_sample(M, PS, accel[i], ms);
+        beats += PS->pulse && !was_inside_beat;
+    }
+
+    return beats;
+}
+
+/*
+    @brief returns true while beats are not accepted because of motion
+    @param Motion Pointer to motion handler
+    @retval gated value
+*/
+bool is_motion_gated(motion_t * M) {
+    return M->gated;
+}
+
+/*
+    @brief fixed point motion stage initialization
+    @param Motion Pointer to fixed point motion handler
+    @param mu NLMS step size, Q15 (1638 = 0.05)
+    @param gate_energy motion energy above which beats are not accepted (counts^2)
+    @param volts_per_count ADC resolution, converts the filtered sample to signal
+    @retval None
+*/
+void motion_q15_init(motion_q15_t * M, int32_t mu, int64_t gate_energy, float volts_per_count) {
+    memset(M, 0, sizeof(*M));
+    M->mu = mu;
+    M->gate_energy = gate_energy;
+    M->volts_per_count = volts_per_count;
+}
+
+/*
+    @brief filters the latest ADC sample and passes it to the pulse sensor
+    @note signal is set to the filtered sample and pulse_sensor_process_sample() is called, while gated
+          signal keeps the filtered sample and only time passes, so no peak, trough or beat comes from motion
+    @param Motion Pointer to fixed point motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param sample raw ADC sample (counts)
+    @param accel accelerometer sample taken with the ADC sample (counts)
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void motion_q15_process_sample(motion_q15_t * M, pulse_sensor_t * PS, int16_t sample, const int16_t accel[MOTION_AXES], uint32_t ms) {
+    if(!M->seeded) {
+        M->seeded = true;
+        M->signal_baseline = (int32_t)sample * 256;
+        for(uint8_t a = 0; a < MOTION_AXES; a++) {
+            M->accel_baseline[a] = (int32_t)accel[a] * 256;
+        }
+    }
+
+    // remove gravity and shift the accelerometer into the delay line
+    int64_t accel_energy = 0;
+    for(uint8_t a = 0; a < MOTION_AXES; a++) {
+        int32_t x = accel[a] - (M->accel_baseline[a] / 256);
+        M->accel_baseline[a] += ((int32_t)accel[a] * 256 - M->accel_baseline[a]) / (1 << MOTION_BASELINE_SHIFT);
+        x = x > INT16_MAX ? INT16_MAX : x < -INT16_MAX ? -INT16_MAX : x;
+        accel_energy += (int64_t)x * x;
+
+        int16_t * line = &M->reference[a * MOTION_TAPS];
+        for(uint8_t t = MOTION_TAPS - 1; t > 0; t--) {
+            line[t] = line[t-1];
+        }
+        line[0] = (int16_t)x;
+    }
+    M->energy += (accel_energy - M->energy) / (1 << MOTION_ENERGY_SHIFT);
+    M->gated = M->energy > M->gate_energy;
+
+    // NLMS: subtract the part of the signal predicted from the accelerometer
+    int32_t d = sample - (M->signal_baseline / 256);
+    M->signal_baseline += ((int32_t)sample * 256 - M->signal_baseline) / (1 << MOTION_BASELINE_SHIFT);
+
+    int64_t y = 0;
+    int64_t power = 1; // never divide by 0
+    for(uint8_t i = 0; i < MOTION_WEIGHTS; i++) {
+        y += (int64_t)M->weights[i] * M->reference[i];
+        power += (int64_t)M->reference[i] * M->reference[i];
+    }
+
+    int32_t e = d - (int32_t)(y / 32768);
+    for(uint8_t i = 0; i < MOTION_WEIGHTS; i++) {
+        M->weights[i] += (int32_t)((int64_t)M->mu * e * M->reference[i] / power);
+    }
+
+    PS->signal = (M->signal_baseline / 256 + e) * M->volts_per_count; // thresh, peak and trough stay in volts
+    pass_to_sensor(PS, M->gated, ms);
+}
+
+/*
+    @brief filters a block of ADC samples and passes them to the pulse sensor
+    @note a plain loop over motion_q15_process_sample(), for samples that arrive in DMA buffers
+    @param Motion Pointer to fixed point motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param samples raw ADC samples (counts)
+    @param accel accelerometer samples, one per ADC sample (counts)
+    @param count number of samples
+    @param ms time (ms) between samples
+    @retval number of beats detected in the block
+*/
+uint16_t motion_q15_process_block(motion_q15_t * M, pulse_sensor_t * PS, const int16_t * samples, const int16_t (*accel)[MOTION_AXES], uint16_t count, uint32_t ms) {
+    uint16_t beats = 0;
+
+    for(uint16_t i = 0; i < count; i++) {
+        bool was_inside_beat = PS->pulse;
+        motion_q15_process_sample(M, PS, samples[i], accel[i], ms);
+        beats += PS->pulse && !was_inside_beat;
+    }
+
+    return beats;
+}
+
+/*
+    @brief returns true while beats are not accepted because of motion
+    @param Motion Pointer to fixed point motion handler
+    @retval gated value
+*/
+bool is_motion_q15_gated(motion_q15_t * M) {
+    return M->gated;
+}
@@ -0,0 +1,153 @@
+/* ****************************************************************************/
+/** Motion Artifact Rejection
+
+  @File Name
+    Motion.h
+
+  @Summary
+    Removes motion artifacts using a synchronized 3-axis accelerometer
+
+  @Description
+    Defines functions for an optional stage in front of pulse_sensor_process_sample(),
+    an NLMS adaptive filter cancels the part of the signal that follows the
+    accelerometer and beats are not accepted while motion energy is high.
+    Float and fixed point (Q15) variants are provided, both with a block call
+    that loops over the per sample call.
+******************************************************************************/
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTION_TAPS 4 // filter taps per accelerometer axis
+#define MOTION_AXES 3
+#define MOTION_WEIGHTS (MOTION_TAPS * MOTION_AXES)
+#define MOTION_BASELINE_SHIFT 6 // baselines follow 1/64 of each sample
+#define MOTION_ENERGY_SHIFT 4 // motion energy follows 1/16 of each sample
+
+typedef struct {
+    // motion settings
+    float mu; // NLMS step size, 0-1
+    float gate_energy; // beats are not accepted while motion energy is above this (accelerometer units^2)
+
+    // motion internal variables
+    float weights[MOTION_WEIGHTS]; // adaptive filter weights
+    float reference[MOTION_WEIGHTS]; // accelerometer delay line, MOTION_TAPS per axis, newest first
+    float accel_baseline[MOTION_AXES]; // gravity and posture, removed from the reference
+    float signal_baseline; // DC level of the signal, restored after filtering
+    float energy; // running average of accelerometer energy
+    bool gated; // true while beats are not accepted
+    bool seeded; // baselines seeded with the first sample
+}motion_t;
+
+typedef struct {
+    // motion settings
+    int32_t mu; // NLMS step size, Q15
+    int64_t gate_energy; // beats are not accepted while motion energy is above this (counts^2)
+    float volts_per_count; // converts the filtered ADC value to signal
+
+    // motion internal variables
+    int32_t weights[MOTION_WEIGHTS]; // adaptive filter weights, Q15
+    int16_t reference[MOTION_WEIGHTS]; // accelerometer delay line, MOTION_TAPS per axis, newest first
+    int32_t accel_baseline[MOTION_AXES]; // gravity and posture, Q8 counts
+    int32_t signal_baseline; // DC level of the signal, Q8 counts
+    int64_t energy; // running average of accelerometer energy (counts^2)
+    bool gated; // true while beats are not accepted
+    bool seeded; // baselines seeded with the first sample
+}motion_q15_t;
+
+/*
+    @brief motion stage initialization
+    @param Motion Pointer to motion handler
+    @param mu NLMS step size, 0-1 (0.05 is a good start)
+    @param gate_energy motion energy above which beats are not accepted (accelerometer units^2)
+    @retval None
+*/
+void motion_init(motion_t * Motion, float mu, float gate_energy);
+
+/*
+    @brief filters the latest sample and passes it to the pulse sensor
+    @note put the raw ADC sample in signal before calling, signal is replaced by the filtered sample
+          and pulse_sensor_process_sample() is called, while gated signal keeps the filtered sample
+          and only time passes, so no peak, trough or beat comes from motion
+    @param Motion Pointer to motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param accel accelerometer sample taken with the ADC sample (x, y, z)
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void motion_process_sample(motion_t * Motion, pulse_sensor_t * Pulse_Sensor, const float accel[MOTION_AXES], uint32_t ms);
+
+/*
+    @brief filters a block of samples and passes them to the pulse sensor
+    @note a plain loop over motion_process_sample(), for samples that arrive in DMA buffers
+    @param Motion Pointer to motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param samples raw ADC samples
+    @param accel accelerometer samples, one per ADC sample
+    @param count number of samples
+    @param ms time (ms) between samples
+    @retval number of beats detected in the block
+*/
+uint16_t motion_process_block(motion_t * Motion, pulse_sensor_t * Pulse_Sensor, const float * samples, const float (*accel)[MOTION_AXES], uint16_t count, uint32_t ms);
+
+/*
+    @brief returns true while beats are not accepted because of motion
+    @param Motion Pointer to motion handler
+    @retval gated value
+*/
+bool is_motion_gated(motion_t * Motion);
+
+/*
+    @brief fixed point motion stage initialization
+    @param Motion Pointer to fixed point motion handler
+    @param mu NLMS step size, Q15 (1638 = 0.05)
+    @param gate_energy motion energy above which beats are not accepted (counts^2)
+    @param volts_per_count ADC resolution, converts the filtered sample to signal
+    @retval None
+*/
+void motion_q15_init(motion_q15_t * Motion, int32_t mu, int64_t gate_energy, float volts_per_count);
+
+/*
+    @brief filters the latest ADC sample and passes it to the pulse sensor
+    @note signal is set to the filtered sample and pulse_sensor_process_sample() is called, while gated
+          signal keeps the filtered sample and only time passes, so no peak, trough or beat comes from motion
+    @param Motion Pointer to fixed point motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param sample raw ADC sample (counts)
+    @param accel accelerometer sample taken with the ADC sample (counts)
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void motion_q15_process_sample(motion_q15_t * Motion, pulse_sensor_t * Pulse_Sensor, int16_t sample, const int16_t accel[MOTION_AXES], uint32_t ms);
+
+/*
+    @brief filters a block of ADC samples and passes them to the pulse sensor
+    @note a plain loop over motion_q15_process_sample(), for samples that arrive in DMA buffers
+    @param Motion Pointer to fixed point motion handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param samples raw ADC samples (counts)
+    @param accel accelerometer samples, one per ADC sample (counts)
+    @param count number of samples
+    @param ms time (ms) between samples
+    @retval number of beats detected in the block
+*/
+uint16_t motion_q15_process_block(motion_q15_t * Motion, pulse_sensor_t * Pulse_Sensor, const int16_t * samples, const int16_t (*accel)[MOTION_AXES], uint16_t count, uint32_t ms);
+
+/*
+    @brief returns true while beats are not accepted because of motion
+    @param Motion Pointer to fixed point motion handler
+    @retval gated value
+*/
+bool is_motion_q15_gated(motion_q15_t * Motion);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_H
@@ -0,0 +1,256 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Profile Store
+
+  @File Name
+    ProfileStore.c
+
+  @Summary
+    Memory mappable per user detector profiles with open addressing lookup
+
+  @Description
+    Implements the open addressing table. IDs are mixed before masking so
+    sequential IDs spread over the table, and removal shifts records back
+    instead of leaving tombstones, so probe runs stay short as users come
+    and go.
+******************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE // ftruncate
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ProfileStore.h"
+#include <string.h>
+
+static bool is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+// splitmix64 finalizer
+static uint32_t slot(profile_store_t * S, uint64_t id) {
+    id ^= id >> 30;
+    id *= 0xBF58476D1CE4E5B9ULL;
+    id ^= id >> 27;
+    id *= 0x94D049BB133111EBULL;
+    id ^= id >> 31;
+    return (uint32_t)id & S->mask;
+}
+
+/*
+    @brief bytes of memory needed for a store
+    @param capacity records in the table, a power of 2
+    @retval size (bytes)
+*/
+size_t profile_store_memory_size(uint32_t capacity) {
+    return sizeof(profile_store_header_t) + (size_t)capacity * sizeof(pulse_profile_t);
+}
+
+/*
+    @brief formats memory as an empty store and attaches to it
+    @param Store Pointer to profile store handler
+    @param memory at least profile_store_memory_size(capacity) bytes, 8 byte aligned
+    @param size size of memory (bytes)
+    @param capacity records in the table, a power of 2
+    @retval true if the store was made
+*/
+bool profile_store_init(profile_store_t * S, void * memory, size_t size, uint32_t capacity) {
+    if(memory == NULL || !is_power_of_two(capacity) || size < profile_store_memory_size(capacity)) {
+        return false;
+    }
+
+    profile_store_header_t * header = (profile_store_header_t *)memory;
+    memset(memory, 0, profile_store_memory_size(capacity)); // PROFILE_STORE_EMPTY is 0
+    header->magic = PROFILE_STORE_MAGIC;
+    header->version = PROFILE_STORE_VERSION;
+    header->record_size = sizeof(pulse_profile_t);
+    header->capacity = capacity;
+    header->count = 0;
+
+    return profile_store_attach(S, memory, size);
+}
+
+/*
+    @brief attaches to a store made by profile_store_init(), e.g. in a mapped file
+    @param Store Pointer to profile store handler
+    @param memory start of the store
+    @param size size of memory (bytes)
+    @retval true if memory holds a valid store of this version and byte order
+*/
+bool profile_store_attach(profile_store_t * S, void * memory, size_t size) {
+    if(memory == NULL || size < sizeof(profile_store_header_t)) {
+        return false;
+    }
+
+    profile_store_header_t * header = (profile_store_header_t *)memory;
+    if(header->magic != PROFILE_STORE_MAGIC || header->version != PROFILE_STORE_VERSION || header->record_size != sizeof(pulse_profile_t) ||
+       !is_power_of_two(header->capacity) || size < profile_store_memory_size(header->capacity)) {
+        return false;
+    }
+
+    S->header = header;
+    S->records = (pulse_profile_t *)(header + 1);
+    S->mask = header->capacity - 1;
+    return true;
+}
+
+/*
+    @brief finds a profile
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval pointer to the profile in the store, NULL if there is none
+*/
+pulse_profile_t * profile_store_find(profile_store_t * S, uint64_t id) {
+    if(id == PROFILE_STORE_EMPTY) {
+        return NULL;
+    }
+    // the load limit guarantees an empty record ends every probe run
+    for(uint32_t i = slot(S, id);; i = (i + 1) & S->mask) {
+        pulse_profile_t * record = &S->records[i];
+        if(record->id == id) {
+            return record;
+        }
+        if(record->id == PROFILE_STORE_EMPTY) {
+            return NULL;
+        }
+    }
+}
+
+/*
+    @brief finds a profile or adds an empty one
+    @note a new profile has only its id set, fill it with pulse_profile_save()
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval pointer to the profile in the store, NULL if id is PROFILE_STORE_EMPTY or the store is full
+*/
+pulse_profile_t * profile_store_put(profile_store_t * S, uint64_t id) {
+    if(id == PROFILE_STORE_EMPTY) {
+        return NULL;
+    }
+    for(uint32_t i = slot(S, id);; i = (i + 1) & S->mask) {
+        pulse_profile_t * record = &S->records[i];
+        if(record->id == id) {
+            return record;
+        }
+        if(record->id == PROFILE_STORE_EMPTY) {
+            if((uint64_t)(S->header->count + 1) * 100 > (uint64_t)S->header->capacity * PROFILE_STORE_LOAD) {
+                return NULL; // full, probe runs would get long
+            }
+            memset(record, 0, sizeof(pulse_profile_t));
+            record->id = id;
+            S->header->count++;
+            return record;
+        }
+    }
+}
+
+/*
+    @brief removes a profile
+    @note moves later records of the same probe run back, so pointers into the store may change
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval true if the profile was there
+*/
+bool profile_store_remove(profile_store_t * S, uint64_t id) {
+    pulse_profile_t * record = profile_store_find(S, id);
+    if(record == NULL) {
+        return false;
+    }
+
+    // move back any later record of the run whose home slot does not lie after the hole
+    uint32_t hole = (uint32_t)(record - S->records);
+    for(uint32_t i = (hole + 1) & S->mask; S->records[i].id != PROFILE_STORE_EMPTY; i = (i + 1) & S->mask) {
+        uint32_t home = slot(S, S->records[i].id);
+        if(((i - home) & S->mask) >= ((i - hole) & S->mask)) {
+            S->records[hole] = S->records[i];
+            hole = i;
+        }
+    }
+    S->records[hole].id = PROFILE_STORE_EMPTY;
+    S->header->count--;
+    return true;
+}
+
+/*
+    @brief saves what a pulse sensor learned in a session to a profile
+    @param Profile Pointer to profile
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void pulse_profile_save(pulse_profile_t * P, const pulse_sensor_t * PS) {
+    P->thresh_setting = PS->thresh_setting;
+    P->trough = PS->thresh - PS->amplitude_mean / 2; // thresh sits at 50% of amplitude
+    P->amplitude = PS->amplitude_mean;
+    P->amplitude_deviation = PS->amplitude_deviation;
+    P->IBI_mean = PS->IBI_mean;
+    P->IBI_deviation = PS->IBI_deviation;
+}
+
+/*
+    @brief heart rate sensor initialization from a profile
+    @note replaces heart_rate_init() and set_threshold()
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param Profile Pointer to profile
+    @retval None
+*/
+void heart_rate_init_profile(pulse_sensor_t * PS, const pulse_profile_t * P) {
+    PS->thresh_setting = P->thresh_setting;
+    heart_rate_init(PS);
+    PS->trough = P->trough;
+    PS->peak = P->trough + P->amplitude;
+    PS->amplitude = P->amplitude;
+    PS->thresh = P->trough + P->amplitude / 2;
+    PS->amplitude_mean = P->amplitude;
+    PS->amplitude_deviation = P->amplitude_deviation;
+    PS->IBI_mean = P->IBI_mean;
+    PS->IBI_deviation = P->IBI_deviation;
+}
+
+#ifdef __linux__
+/*
+    @brief maps a store file into memory, shared with every process that maps it
+    @note a new or empty file is sized and formatted for capacity records, an existing one is attached,
+          writers must still be serialized by the caller, the file descriptor is closed so open the file
+          again to lock it
+    @param Store Pointer to profile store handler
+    @param path file path
+    @param capacity records in the table of a new store, a power of 2
+    @retval true if the store is mapped, false if capacity is not a power of 2 for a new file
+*/
+bool profile_store_map_file(profile_store_t * S, const char * path, uint32_t capacity) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    bool fresh = st.st_size == 0;
+    if(fresh && !is_power_of_two(capacity)) {
+        close(fd);
+        return false; // before sizing, a file left zero filled would never attach
+    }
+    size_t size = fresh ? profile_store_memory_size(capacity) : (size_t)st.st_size;
+    if(fresh && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void * memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if(memory == MAP_FAILED) {
+        return false;
+    }
+
+    bool ok = fresh ? profile_store_init(S, memory, size, capacity) : profile_store_attach(S, memory, size);
+    if(!ok) {
+        munmap(memory, size);
+    }
+    return ok;
+}
+#endif
@@ -0,0 +1,151 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Profile Store
+
+  @File Name
+    ProfileStore.h
+
+  @Summary
+    Memory mappable per user detector profiles with open addressing lookup
+
+  @Description
+    Defines a store of fixed size profiles keyed by a 64 bit user or device
+    ID, laid out in one block of caller provided memory (e.g. an mmap of a
+    file shared by many host processes): a header followed by a power of two
+    table of records, linear probing. A profile holds the tuned threshold
+    and learned signal statistics, so a new pulse sensor is seeded from one
+    lookup instead of a database round trip. Records are in host byte order.
+    The store has no locking: one process (or thread) at a time may write
+    (put, remove, filling a profile), and while it does, readers in other
+    processes must be kept out with an external lock such as flock() on a
+    separately opened descriptor of the store file, since remove() moves
+    records and a new record is briefly half filled.
+******************************************************************************/
+
+#ifndef PROFILE_STORE_H
+#define PROFILE_STORE_H
+
+#include "HeartRate.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_STORE_MAGIC 0x46505350 // "PSPF", reads differently in the other byte order
+#define PROFILE_STORE_VERSION 1
+#define PROFILE_STORE_EMPTY 0 // ID of an empty record, not a valid user or device ID
+#define PROFILE_STORE_LOAD 80 // percent of the table put() fills before it refuses new IDs
+
+typedef struct {
+    uint64_t id; // user or device ID, PROFILE_STORE_EMPTY if the record is free
+    float thresh_setting; // seed and reset thresh
+    float trough; // typical trough (sample value)
+    float amplitude; // learned amplitude_mean
+    float amplitude_deviation;
+    float IBI_mean; // ms
+    float IBI_deviation; // ms
+}pulse_profile_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size; // sizeof(pulse_profile_t) when the store was made
+    uint32_t capacity; // records in the table, a power of 2
+    uint32_t count; // records in use
+    uint8_t reserved[16]; // keeps the records 32 byte aligned
+}profile_store_header_t;
+
+typedef struct {
+    profile_store_header_t * header;
+    pulse_profile_t * records;
+    uint32_t mask; // capacity - 1
+}profile_store_t;
+
+/*
+    @brief bytes of memory needed for a store
+    @param capacity records in the table, a power of 2
+    @retval size (bytes)
+*/
+size_t profile_store_memory_size(uint32_t capacity);
+
+/*
+    @brief formats memory as an empty store and attaches to it
+    @param Store Pointer to profile store handler
+    @param memory at least profile_store_memory_size(capacity) bytes, 8 byte aligned
+    @param size size of memory (bytes)
+    @param capacity records in the table, a power of 2
+    @retval true if the store was made
+*/
+bool profile_store_init(profile_store_t * Store, void * memory, size_t size, uint32_t capacity);
+
+/*
+    @brief attaches to a store made by profile_store_init(), e.g. in a mapped file
+    @param Store Pointer to profile store handler
+    @param memory start of the store
+    @param size size of memory (bytes)
+    @retval true if memory holds a valid store of this version and byte order
+*/
+bool profile_store_attach(profile_store_t * Store, void * memory, size_t size);
+
+/*
+    @brief finds a profile
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval pointer to the profile in the store, NULL if there is none
+*/
+pulse_profile_t * profile_store_find(profile_store_t * Store, uint64_t id);
+
+/*
+    @brief finds a profile or adds an empty one
+    @note a new profile has only its id set, fill it with pulse_profile_save()
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval pointer to the profile in the store, NULL if id is PROFILE_STORE_EMPTY or the store is full
+*/
+pulse_profile_t * profile_store_put(profile_store_t * Store, uint64_t id);
+
+/*
+    @brief removes a profile
+    @note moves later records of the same probe run back, so pointers into the store may change
+    @param Store Pointer to profile store handler
+    @param id user or device ID
+    @retval true if the profile was there
+*/
+bool profile_store_remove(profile_store_t * Store, uint64_t id);
+
+/*
+    @brief saves what a pulse sensor learned in a session to a profile
+    @param Profile Pointer to profile
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void pulse_profile_save(pulse_profile_t * Profile, const pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief heart rate sensor initialization from a profile
+    @note replaces heart_rate_init() and set_threshold()
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param Profile Pointer to profile
+    @retval None
+*/
+void heart_rate_init_profile(pulse_sensor_t * Pulse_Sensor, const pulse_profile_t * Profile);
+
+#ifdef __linux__
+/*
+    @brief maps a store file into memory, shared with every process that maps it
+    @note a new or empty file is sized and formatted for capacity records, an existing one is attached,
+          writers must still be serialized by the caller, the file descriptor is closed so open the file
+          again to lock it
+    @param Store Pointer to profile store handler
+    @param path file path
+    @param capacity records in the table of a new store, a power of 2
+    @retval true if the store is mapped, false if capacity is not a power of 2 for a new file
+*/
+bool profile_store_map_file(profile_store_t * Store, const char * path, uint32_t capacity);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_STORE_H
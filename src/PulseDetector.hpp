@@ -0,0 +1,182 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor C++ Wrapper
+
+  @File Name
+    PulseDetector.hpp
+
+  @Summary
+    Header-only C++ template over the pulse sensor C core
+
+  @Description
+    PulseDetector<Config> owns a pulse_sensor_t and the optional per-beat
+    stages (HRV, median IBI). The sample type, ADC scale, sample period and
+    enabled features come from Config at compile time, so disabled stages
+    take no storage and their calls compile away. Requires C++20.
+
+    The rate window, refractory time and reset time are not Config options:
+    they are the C core's PULSE_RATE_WINDOW, PULSE_REFRACTORY_MS and
+    PULSE_RESET_MS macros, and PULSE_RATE_WINDOW sizes pulse_sensor_t. Set
+    them once for the whole program (every translation unit and the C
+    core) with -D. The C core is compiled separately, so its calls are
+    only inlined into process() with link time optimization (-flto).
+******************************************************************************/
+
+#ifndef PULSE_DETECTOR_HPP
+#define PULSE_DETECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "HeartRate.h"
+#include "HRV.h"
+#include "MedianIBI.h"
+
+namespace pulse {
+
+// fixed point sample, value = raw / 2^FracBits volts
+template <int FracBits>
+struct Fixed {
+    static_assert(FracBits > 0 && FracBits < 31, "FracBits must fit an int32_t");
+    static constexpr int frac_bits = FracBits;
+    int32_t raw;
+};
+
+// Config to derive from, override only what differs
+struct DefaultConfig {
+    using Sample = float; // float (volts), int16_t (ADC counts) or Fixed<FracBits>
+    static constexpr float volts_per_count = 1.0f; // only used for integer samples
+    static constexpr uint32_t sample_period_ms = 2; // time between samples in process()
+
+    static constexpr bool interpolate = false; // see set_beat_interpolation()
+    static constexpr bool hrv = false; // keep an hrv_t fed with accepted beats
+    static constexpr uint8_t hrv_max_beats = HRV_MAX_BEATS;
+    static constexpr uint32_t hrv_window_ms = 0;
+    static constexpr bool median_ibi = false; // keep a median_ibi_t, outliers are not passed to HRV
+};
+
+namespace detail {
+
+struct Empty {};
+
+template <typename T>
+struct is_fixed : std::false_type {};
+
+template <int FracBits>
+struct is_fixed<Fixed<FracBits>> : std::true_type {};
+
+template <typename Config>
+constexpr float to_signal(typename Config::Sample sample) {
+    using Sample = typename Config::Sample;
+    if constexpr (std::is_floating_point_v<Sample>) {
+        return static_cast<float>(sample);
+    } else if constexpr (is_fixed<Sample>::value) {
+        return static_cast<float>(sample.raw) * (1.0f / static_cast<float>(1L << Sample::frac_bits));
+    } else {
+        static_assert(std::is_integral_v<Sample>, "Sample must be floating point, integral or Fixed<>");
+        return static_cast<float>(sample) * Config::volts_per_count;
+    }
+}
+
+} // namespace detail
+
+template <typename Config = DefaultConfig>
+class PulseDetector {
+public:
+    using Sample = typename Config::Sample;
+
+    static_assert(Config::sample_period_ms > 0, "sample_period_ms must be at least 1");
+
+    /*
+        @brief initializes the pulse sensor and enabled stages
+        @param thresh_setting used to seed and reset thresh, sample value in volts
+    */
+    explicit PulseDetector(float thresh_setting) {
+        ps_.thresh_setting = thresh_setting; // heart_rate_init() seeds thresh and prev_signal from it
+        heart_rate_init(&ps_);
+        set_beat_interpolation(&ps_, Config::interpolate);
+        if constexpr (Config::hrv) {
+            hrv_init(&hrv_, Config::hrv_max_beats, Config::hrv_window_ms);
+        }
+        if constexpr (Config::median_ibi) {
+            median_ibi_init(&median_);
+        }
+        reset_count_ = get_reset_count(&ps_);
+    }
+
+    /*
+        @brief processes one sample taken sample_period_ms after the last one
+        @retval true if a beat started on this sample
+    */
+    bool process(Sample sample) {
+        return process(sample, Config::sample_period_ms);
+    }
+
+    /*
+        @brief processes one sample taken ms after the last one
+        @retval true if a beat started on this sample
+    */
+    bool process(Sample sample, uint32_t ms) {
+        ps_.signal = detail::to_signal<Config>(sample);
+        pulse_sensor_process_sample(&ps_, ms);
+        if constexpr (Config::hrv) {
+            if (get_reset_count(&ps_) != reset_count_) {
+                hrv_reset(&hrv_); // IBIs on either side of a reset are not successive
+            }
+        }
+        reset_count_ = get_reset_count(&ps_);
+        if (!take_start_of_beat(&ps_)) {
+            return false;
+        }
+        on_beat(get_inter_beat_interval(&ps_));
+        return true;
+    }
+
+    /*
+        @brief processes a block of samples, sample_period_ms apart
+        @retval number of beats that started in the block
+    */
+    std::size_t process(std::span<const Sample> samples) {
+        std::size_t beats = 0;
+        for (Sample sample : samples) {
+            beats += process(sample, Config::sample_period_ms);
+        }
+        return beats;
+    }
+
+    uint8_t bpm() const { return ps_.BPM; }
+    uint32_t ibi() const { return ps_.IBI; }
+    float amplitude() const { return ps_.amplitude; }
+    uint8_t quality() const { return ps_.quality; }
+    bool inside_beat() const { return ps_.pulse; }
+    uint64_t last_beat_time() const { return ps_.last_beat_time; }
+
+    pulse_sensor_t & sensor() { return ps_; }
+    const pulse_sensor_t & sensor() const { return ps_; }
+
+    hrv_t & hrv() requires (Config::hrv) { return hrv_; }
+    median_ibi_t & median() requires (Config::median_ibi) { return median_; }
+
+private:
+    void on_beat(uint32_t ibi) {
+        if constexpr (Config::median_ibi) {
+            if (!median_ibi_add_beat(&median_, ibi)) {
+                return;
+            }
+        }
+        if constexpr (Config::hrv) {
+            hrv_add_beat(&hrv_, ibi);
+        }
+        (void)ibi;
+    }
+
+    pulse_sensor_t ps_{};
+    uint32_t reset_count_;
+    [[no_unique_address]] std::conditional_t<Config::hrv, hrv_t, detail::Empty> hrv_;
+    [[no_unique_address]] std::conditional_t<Config::median_ibi, median_ibi_t, detail::Empty> median_;
+};
+
+} // namespace pulse
+
+#endif // PULSE_DETECTOR_HPP
@@ -0,0 +1,268 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Coroutine Stream
+
+  @File Name
+    PulseStream.hpp
+
+  @Summary
+    C++20 coroutine interface that turns sample chunks into beat events
+
+  @Description
+    A stream coroutine waits for sample chunks with co_await next_chunk, runs
+    them through a PulseDetector and co_yields a BeatEvent for every beat.
+    Coroutine frames come from a fixed FramePool passed as the last coroutine
+    argument, so starting or running streams never touches the heap.
+    Requires C++20.
+******************************************************************************/
+
+#ifndef PULSE_STREAM_HPP
+#define PULSE_STREAM_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "PulseDetector.hpp"
+
+namespace pulse {
+
+struct BeatEvent {
+    uint64_t time; // last_beat_time of the beat (ms)
+    uint32_t ibi; // inter beat interval (ms)
+    uint8_t bpm; // beats per minute after the beat
+    float amplitude; // amplitude of the previous pulse
+};
+
+// free list of equal size coroutine frames, not thread safe, use one pool per thread
+class FramePoolBase {
+public:
+    FramePoolBase(const FramePoolBase &) = delete;
+    FramePoolBase & operator=(const FramePoolBase &) = delete;
+
+    /*
+        @brief takes a frame from the pool
+        @retval frame, nullptr if size does not fit a frame or the pool is empty
+    */
+    void * allocate(std::size_t size) noexcept {
+        if (size > frame_size_ - header || free_ == nullptr) {
+            return nullptr;
+        }
+        Node * node = free_;
+        free_ = node->next;
+        --available_;
+        *reinterpret_cast<FramePoolBase **>(node) = this; // remembered for release()
+        return reinterpret_cast<unsigned char *>(node) + header;
+    }
+
+    /*
+        @brief returns a frame from allocate() to the pool it came from
+    */
+    static void release(void * frame) noexcept {
+        unsigned char * block = static_cast<unsigned char *>(frame) - header;
+        FramePoolBase * pool = *reinterpret_cast<FramePoolBase **>(block);
+        Node * node = reinterpret_cast<Node *>(block);
+        node->next = pool->free_;
+        pool->free_ = node;
+        ++pool->available_;
+    }
+
+    std::size_t available() const { return available_; }
+
+protected:
+    // frames keep a pointer back to their pool in front of the coroutine frame
+    static constexpr std::size_t header = alignof(std::max_align_t);
+
+    FramePoolBase(unsigned char * storage, std::size_t frame_size, std::size_t frames)
+        : free_(nullptr), frame_size_(frame_size), available_(frames) {
+        for (std::size_t i = frames; i > 0; i--) {
+            Node * node = reinterpret_cast<Node *>(storage + (i - 1) * frame_size);
+            node->next = free_;
+            free_ = node;
+        }
+    }
+
+private:
+    struct Node {
+        Node * next;
+    };
+
+    Node * free_;
+    std::size_t frame_size_;
+    std::size_t available_;
+};
+
+/*
+    FrameSize is the coroutine frame size plus alignof(std::max_align_t), the
+    frame size depends on the compiler, so check valid() on new streams
+*/
+template <std::size_t FrameSize, std::size_t Frames>
+class FramePool : public FramePoolBase {
+    static constexpr std::size_t frame_size = (FrameSize + header + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+public:
+    FramePool() : FramePoolBase(storage_, frame_size, Frames) {}
+
+private:
+    alignas(std::max_align_t) unsigned char storage_[frame_size * Frames];
+};
+
+// co_await next_chunk in a stream coroutine to get the next chunk given to feed()
+struct NextChunk {};
+inline constexpr NextChunk next_chunk{};
+
+template <typename Sample>
+class BeatStream {
+public:
+    struct promise_type {
+        std::span<const Sample> chunk;
+        bool has_chunk = false; // chunk given to feed() and not picked up yet
+        bool waiting = true; // suspended in co_await next_chunk (or not started)
+        std::optional<BeatEvent> beat; // yielded and not picked up by next() yet
+
+        template <typename... Args>
+        static void * operator new(std::size_t size, Args &... args) noexcept {
+            auto & pool = std::get<sizeof...(Args) - 1>(std::tie(args...)); // frame pool is the last coroutine argument
+            static_assert(std::is_base_of_v<FramePoolBase, std::remove_cvref_t<decltype(pool)>>,
+                          "the last stream coroutine argument must be a FramePool");
+            return pool.allocate(size);
+        }
+
+        // sized, so it pairs with the placement style operator new above, the pool does not need the size
+        static void operator delete(void * frame, std::size_t) noexcept {
+            FramePoolBase::release(frame);
+        }
+
+        static BeatStream get_return_object_on_allocation_failure() noexcept {
+            return BeatStream(nullptr);
+        }
+
+        BeatStream get_return_object() noexcept {
+            return BeatStream(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+
+        std::suspend_always yield_value(const BeatEvent & event) noexcept {
+            beat = event;
+            return {};
+        }
+
+        auto await_transform(NextChunk) noexcept {
+            struct Awaiter {
+                promise_type & promise;
+
+                bool await_ready() const noexcept {
+                    return promise.has_chunk;
+                }
+
+                void await_suspend(std::coroutine_handle<>) const noexcept {
+                    promise.waiting = true;
+                }
+
+                std::span<const Sample> await_resume() const noexcept {
+                    promise.has_chunk = false;
+                    promise.waiting = false;
+                    return promise.chunk;
+                }
+            };
+            return Awaiter{*this};
+        }
+    };
+
+    BeatStream(BeatStream && other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    BeatStream & operator=(BeatStream && other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~BeatStream() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    /*
+        @brief returns false if the frame pool had no frame for the stream
+    */
+    bool valid() const { return static_cast<bool>(handle_); }
+
+    /*
+        @brief gives the stream its next chunk of samples
+        @note the chunk must stay valid until next() returns no beat
+        @retval false if the stream is still working through the previous chunk
+    */
+    bool feed(std::span<const Sample> chunk) {
+        promise_type & promise = handle_.promise();
+        if (!promise.waiting || promise.has_chunk || handle_.done()) {
+            return false;
+        }
+        promise.chunk = chunk;
+        promise.has_chunk = true;
+        return true;
+    }
+
+    /*
+        @brief runs the stream until its next beat
+        @retval beat event, nothing once the chunk is used up (feed the next one)
+    */
+    std::optional<BeatEvent> next() {
+        promise_type & promise = handle_.promise();
+        if (handle_.done() || (promise.waiting && !promise.has_chunk)) {
+            return std::nullopt;
+        }
+        handle_.resume();
+        return std::exchange(promise.beat, std::nullopt);
+    }
+
+private:
+    explicit BeatStream(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/*
+    @brief stream coroutine for one sensor connection
+    @note the detector and pool must outlive the stream
+    @param detector PulseDetector (or a type with the same interface) fed with every sample
+    @param pool frame pool the coroutine frame is taken from
+    @retval stream, check valid()
+*/
+#if defined(__GNUC__) && !defined(__clang__)
+// g++ pairs the templated promise operator new with its operator delete as mismatched at -O0, a false positive
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+template <typename Detector>
+BeatStream<typename Detector::Sample> beat_stream(Detector & detector, FramePoolBase & pool) {
+    (void)pool; // only used by promise_type::operator new
+    for (;;) {
+        std::span<const typename Detector::Sample> chunk = co_await next_chunk;
+        for (const auto & sample : chunk) {
+            if (detector.process(sample)) {
+                co_yield BeatEvent{detector.last_beat_time(), detector.ibi(), detector.bpm(), detector.amplitude()};
+            }
+        }
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace pulse
+
+#endif // PULSE_STREAM_HPP
@@ -0,0 +1,124 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Pulse Transit Time
+
+  @File Name
+    PulseTransit.c
+
+  @Summary
+    Pulse transit time from two synchronized pulse sensors
+
+  @Description
+    Implements functions that detect beats on both channels from beat_count
+    and reset_count and match them. Both sensors see the same ms values, so
+    their sample_counter and last_beat_time share one time base.
+******************************************************************************/
+
+#include "PulseTransit.h"
+
+// true if the sensor detected a beat on this sample
+static bool saw_beat(pulse_sensor_t * PS, uint32_t * beat_count, uint32_t * reset_count) {
+    bool beat = PS->beat_count != *beat_count && PS->reset_count == *reset_count;
+    *beat_count = PS->beat_count;
+    *reset_count = PS->reset_count;
+    return beat;
+}
+
+/*
+    @brief pulse transit initialization
+    @note heart_rate_init() and set_threshold() must be called on both sensors first, beat interpolation is turned on for both
+    @param Transit Pointer to pulse transit handler
+    @param proximal Pointer to the pulse sensor closer to the heart
+    @param distal Pointer to the pulse sensor further from the heart
+    @param min_ms shortest accepted transit time (ms)
+    @param max_ms longest accepted transit time (ms)
+    @retval None
+*/
+void pulse_transit_init(pulse_transit_t * PT, pulse_sensor_t * proximal, pulse_sensor_t * distal, float min_ms, float max_ms) {
+    PT->PTT = 0;
+    PT->ready = false;
+    PT->unmatched = 0;
+    PT->proximal = proximal;
+    PT->distal = distal;
+    PT->min_ms = min_ms;
+    PT->max_ms = max_ms;
+    PT->proximal_pending = false;
+    PT->proximal_beat_count = proximal->beat_count;
+    PT->distal_beat_count = distal->beat_count;
+    PT->proximal_reset_count = proximal->reset_count;
+    PT->distal_reset_count = distal->reset_count;
+    set_beat_interpolation(proximal, true);
+    set_beat_interpolation(distal, true);
+}
+
+/*
+    @brief processes one sample of each sensor, taken at the same time
+    @param Transit Pointer to pulse transit handler
+    @param proximal_signal latest sample of the proximal sensor
+    @param distal_signal latest sample of the distal sensor
+    @param ms time (ms) since the last samples
+    @retval true if a new PTT is ready
+*/
+bool pulse_transit_process_sample(pulse_transit_t * PT, float proximal_signal, float distal_signal, uint32_t ms) {
+    PT->proximal->signal = proximal_signal;
+    PT->distal->signal = distal_signal;
+    pulse_sensor_process_sample(PT->proximal, ms);
+    pulse_sensor_process_sample(PT->distal, ms);
+
+    if(PT->proximal->reset_count != PT->proximal_reset_count) {
+        PT->proximal_pending = false; // the waiting beat belongs to a lost pulse
+    }
+    if(saw_beat(PT->proximal, &PT->proximal_beat_count, &PT->proximal_reset_count)) {
+        PT->proximal_pending = true;
+        PT->proximal_beat_time = PT->proximal->last_beat_time;
+        PT->proximal_beat_offset = PT->proximal->beat_offset;
+    }
+
+    if(!saw_beat(PT->distal, &PT->distal_beat_count, &PT->distal_reset_count)) {
+        return false;
+    }
+    if(!PT->proximal_pending) {
+        PT->unmatched++;
+        return false;
+    }
+
+    // whole ms first so large sample_counter values keep their precision in float
+    int64_t whole = (int64_t)(PT->distal->last_beat_time - PT->proximal_beat_time);
+    float ptt = (float)whole - (PT->distal->beat_offset - PT->proximal_beat_offset);
+    if(ptt < PT->min_ms) {
+        PT->unmatched++; // distal beat of an earlier heart beat, or noise, keep waiting
+        return false;
+    }
+    PT->proximal_pending = false;
+    if(ptt > PT->max_ms) {
+        PT->unmatched++; // the matching distal beat was missed
+        return false;
+    }
+
+    PT->PTT = ptt;
+    PT->ready = true;
+    return true;
+}
+
+/*
+    @brief reads and clears the latest pulse transit time
+    @param Transit Pointer to pulse transit handler
+    @param ptt set to the pulse transit time (ms) if a new one is ready
+    @retval true if a new PTT was ready
+*/
+bool pulse_transit_get(pulse_transit_t * PT, float * ptt) {
+    if(!PT->ready) {
+        return false;
+    }
+    *ptt = PT->PTT;
+    PT->ready = false;
+    return true;
+}
+
+/*
+    @brief get the latest pulse transit time
+    @param Transit Pointer to pulse transit handler
+    @retval PTT value (ms), 0 before the first matched beat
+*/
+float get_pulse_transit_time(pulse_transit_t * PT) {
+    return PT->PTT;
+}
@@ -0,0 +1,89 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Pulse Transit Time
+
+  @File Name
+    PulseTransit.h
+
+  @Summary
+    Pulse transit time from two synchronized pulse sensors
+
+  @Description
+    Defines functions that process a proximal (e.g. ear) and a distal (e.g.
+    finger) pulse sensor in lockstep and pair each distal beat with the
+    proximal beat before it. Beat times are interpolated between samples, so
+    the pulse transit time has sub-sample precision.
+******************************************************************************/
+
+#ifndef PULSE_TRANSIT_H
+#define PULSE_TRANSIT_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // pulse transit output variables
+    float PTT; // latest pulse transit time (ms)
+    bool ready; // PTT was updated and not read yet
+    uint32_t unmatched; // distal beats without a proximal beat inside the window
+
+    // pulse transit settings
+    pulse_sensor_t * proximal; // sensor closer to the heart
+    pulse_sensor_t * distal;
+    float min_ms; // shortest accepted transit time
+    float max_ms; // longest accepted transit time, keep below the shortest IBI
+
+    // pulse transit internal variables
+    bool proximal_pending; // a proximal beat is waiting for its distal beat
+    uint64_t proximal_beat_time; // last_beat_time of the waiting proximal beat
+    float proximal_beat_offset; // beat_offset of the waiting proximal beat
+    uint32_t proximal_beat_count; // beat_count seen, a change is a beat
+    uint32_t distal_beat_count;
+    uint32_t proximal_reset_count; // reset_count seen, a change is a reset
+    uint32_t distal_reset_count;
+}pulse_transit_t;
+
+/*
+    @brief pulse transit initialization
+    @note heart_rate_init() and set_threshold() must be called on both sensors first, beat interpolation is turned on for both
+    @param Transit Pointer to pulse transit handler
+    @param proximal Pointer to the pulse sensor closer to the heart
+    @param distal Pointer to the pulse sensor further from the heart
+    @param min_ms shortest accepted transit time (ms)
+    @param max_ms longest accepted transit time (ms)
+    @retval None
+*/
+void pulse_transit_init(pulse_transit_t * Transit, pulse_sensor_t * proximal, pulse_sensor_t * distal, float min_ms, float max_ms);
+
+/*
+    @brief processes one sample of each sensor, taken at the same time
+    @param Transit Pointer to pulse transit handler
+    @param proximal_signal latest sample of the proximal sensor
+    @param distal_signal latest sample of the distal sensor
+    @param ms time (ms) since the last samples
+    @retval true if a new PTT is ready
+*/
+bool pulse_transit_process_sample(pulse_transit_t * Transit, float proximal_signal, float distal_signal, uint32_t ms);
+
+/*
+    @brief reads and clears the latest pulse transit time
+    @param Transit Pointer to pulse transit handler
+    @param ptt set to the pulse transit time (ms) if a new one is ready
+    @retval true if a new PTT was ready
+*/
+bool pulse_transit_get(pulse_transit_t * Transit, float * ptt);
+
+/*
+    @brief get the latest pulse transit time
+    @param Transit Pointer to pulse transit handler
+    @retval PTT value (ms), 0 before the first matched beat
+*/
+float get_pulse_transit_time(pulse_transit_t * Transit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PULSE_TRANSIT_H
@@ -0,0 +1,252 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Quantile Sketch
+
+  @File Name
+    QuantileSketch.c
+
+  @Summary
+    Mergeable streaming quantiles (p5, p50, p95...) of BPM in fixed memory
+
+  @Description
+    Implements the compactor levels in one buffer, lowest level first with
+    the free space in front of it, so adding a value is a store and
+    compacting a level moves only the smaller levels below it. Quantiles
+    walk all levels in value order (a merge of the sorted levels) and add
+    up the level weights.
+******************************************************************************/
+
+#include "QuantileSketch.h"
+
+#define END QUANTILE_SKETCH_CAPACITY
+
+static void sort_level(float * items, uint16_t size) {
+    // insertion sort, levels are small and partly sorted after a compaction
+    for(uint16_t i = 1; i < size; i++) {
+        float value = items[i];
+        int32_t j = i - 1;
+        while(j >= 0 && items[j] > value) {
+            items[j+1] = items[j];
+            j--;
+        }
+        items[j+1] = value;
+    }
+}
+
+static uint16_t level_size(const quantile_sketch_t * S, uint8_t level) {
+    return S->levels[level + 1] - S->levels[level];
+}
+
+// K for the top level, 2/3 of the level above for the rest, at least 2
+static uint16_t level_capacity(const quantile_sketch_t * S, uint8_t level) {
+    uint32_t capacity = QUANTILE_SKETCH_K;
+    for(uint8_t depth = S->num_levels - 1 - level; depth > 0 && capacity > 2; depth--) {
+        capacity = (2 * capacity + 2) / 3;
+    }
+    return (uint16_t)capacity;
+}
+
+// adds an empty top level, the levels below get smaller capacities
+static void add_level(quantile_sketch_t * S) {
+    S->num_levels++;
+    S->levels[S->num_levels] = END;
+    S->capacity = 0;
+    for(uint8_t level = 0; level < S->num_levels; level++) {
+        S->capacity += level_capacity(S, level);
+    }
+}
+
+// moves every other value of the level up (the top level keeps them when there is no room for
+// another level), the rest is dropped, an odd value out stays in the level
+static void compact(quantile_sketch_t * S, uint8_t level) {
+    float * items = S->items;
+    uint16_t start = S->levels[level];
+    uint16_t end = S->levels[level + 1];
+    uint16_t odd = (end - start) & 1;
+    uint16_t half = (end - start - odd) / 2;
+    uint16_t offset = (S->parity >> level) & 1;
+
+    S->parity ^= (uint32_t)1 << level;
+    sort_level(items + start, end - start);
+
+    // the kept half goes to the end of the level, highest first so no value is overwritten before it is read
+    for(uint16_t i = half; i > 0; i--) {
+        items[start + odd + half + i - 1] = items[start + odd + offset + 2 * (i - 1)];
+    }
+
+    // close the gap of half dropped values by moving everything below up
+    uint16_t below = S->levels[0];
+    for(uint16_t i = start + odd; i > below; i--) {
+        items[i - 1 + half] = items[i - 1];
+    }
+    for(uint8_t l = 0; l <= level; l++) {
+        S->levels[l] += half;
+    }
+    if(level < S->num_levels - 1) {
+        S->levels[level + 1] = end - half;
+    }
+}
+
+// makes room for one value by compacting the lowest level at its capacity
+static void compress(quantile_sketch_t * S) {
+    uint8_t level = 0;
+    while(level < S->num_levels - 1 && level_size(S, level) < level_capacity(S, level)) {
+        level++;
+    }
+    if(level == S->num_levels - 1 && S->num_levels < QUANTILE_SKETCH_LEVELS) {
+        add_level(S);
+    }
+    compact(S, level);
+}
+
+// adds a value of weight 2^level, the levels below move down one to make room
+static void push(quantile_sketch_t * S, uint8_t level, float value) {
+    while(level >= S->num_levels) {
+        add_level(S);
+    }
+    if(END - S->levels[0] >= S->capacity) {
+        compress(S);
+    }
+    for(uint16_t i = S->levels[0]; i < S->levels[level]; i++) {
+        S->items[i - 1] = S->items[i];
+    }
+    for(uint8_t l = 0; l <= level; l++) {
+        S->levels[l]--;
+    }
+    S->items[S->levels[level]] = value;
+}
+
+/*
+    @brief quantile sketch initialization
+    @param Sketch Pointer to quantile sketch handler
+    @retval None
+*/
+void quantile_sketch_init(quantile_sketch_t * S) {
+    S->count = 0;
+    S->min = 0;
+    S->max = 0;
+    S->parity = 0;
+    S->num_levels = 0;
+    S->levels[0] = END;
+    add_level(S);
+}
+
+/*
+    @brief adds a value
+    @note e.g. 60000 / IBI of every accepted beat, amortized O(1)
+    @param Sketch Pointer to quantile sketch handler
+    @param value value to add
+    @retval None
+*/
+void quantile_sketch_add(quantile_sketch_t * S, float value) {
+    if(S->count == 0 || value < S->min) {
+        S->min = value;
+    }
+    if(S->count == 0 || value > S->max) {
+        S->max = value;
+    }
+    S->count++;
+    push(S, 0, value);
+}
+
+/*
+    @brief adds all values of another sketch
+    @param Sketch Pointer to quantile sketch handler that receives the values
+    @param Other Pointer to quantile sketch handler to merge, left unchanged
+    @retval None
+*/
+void quantile_sketch_merge(quantile_sketch_t * S, const quantile_sketch_t * Other) {
+    if(Other->count == 0) {
+        return;
+    }
+    if(S->count == 0 || Other->min < S->min) {
+        S->min = Other->min;
+    }
+    if(S->count == 0 || Other->max > S->max) {
+        S->max = Other->max;
+    }
+    S->count += Other->count;
+
+    // lower levels first, their compactions carry values up before the higher levels are added
+    for(uint8_t level = 0; level < Other->num_levels; level++) {
+        for(uint16_t i = Other->levels[level]; i < Other->levels[level + 1]; i++) {
+            push(S, level, Other->items[i]);
+        }
+    }
+}
+
+/*
+    @brief estimates a quantile
+    @note sorts the levels in place, O(K * LEVELS)
+    @param Sketch Pointer to quantile sketch handler
+    @param q quantile 0-1, e.g. 0.95 for p95
+    @retval value, 0 if the sketch is empty
+*/
+float quantile_sketch_quantile(quantile_sketch_t * S, float q) {
+    if(S->count == 0) {
+        return 0;
+    }
+    if(q <= 0) {
+        return S->min;
+    }
+    if(q >= 1) {
+        return S->max;
+    }
+
+    uint64_t total = 0;
+    uint16_t next[QUANTILE_SKETCH_LEVELS];
+    for(uint8_t level = 0; level < S->num_levels; level++) {
+        sort_level(S->items + S->levels[level], level_size(S, level));
+        total += (uint64_t)level_size(S, level) << level;
+        next[level] = S->levels[level];
+    }
+
+    // weights may not add up to count once values were dropped, rank against the weights
+    float target = q * (float)total;
+    uint64_t below = 0;
+    for(;;) {
+        int8_t smallest = -1;
+        for(uint8_t level = 0; level < S->num_levels; level++) {
+            if(next[level] < S->levels[level + 1] &&
+               (smallest < 0 || S->items[next[level]] < S->items[next[smallest]])) {
+                smallest = (int8_t)level;
+            }
+        }
+        if(smallest < 0) {
+            return S->max;
+        }
+        float value = S->items[next[smallest]++];
+        below += (uint64_t)1 << smallest;
+        if((float)below >= target) {
+            return value;
+        }
+    }
+}
+
+/*
+    @brief estimates the share of added values at or below value
+    @param Sketch Pointer to quantile sketch handler
+    @param value value to rank
+    @retval rank 0-1, 0 if the sketch is empty
+*/
+float quantile_sketch_rank(const quantile_sketch_t * S, float value) {
+    uint64_t total = 0;
+    uint64_t below = 0;
+    for(uint8_t level = 0; level < S->num_levels; level++) {
+        for(uint16_t i = S->levels[level]; i < S->levels[level + 1]; i++) {
+            total += (uint64_t)1 << level;
+            if(S->items[i] <= value) {
+                below += (uint64_t)1 << level;
+            }
+        }
+    }
+    return total == 0 ? 0 : (float)below / (float)total;
+}
+
+/*
+    @brief get the number of values added
+    @param Sketch Pointer to quantile sketch handler
+    @retval count value
+*/
+uint64_t quantile_sketch_count(const quantile_sketch_t * S) {
+    return S->count;
+}
@@ -0,0 +1,99 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Quantile Sketch
+
+  @File Name
+    QuantileSketch.h
+
+  @Summary
+    Mergeable streaming quantiles (p5, p50, p95...) of BPM in fixed memory
+
+  @Description
+    Defines a KLL sketch: level l holds values that each stand for 2^l
+    added values. The top level holds up to QUANTILE_SKETCH_K values and
+    each level below holds 2/3 as many (at least 2), so memory stays near
+    3 K values however many levels are in use. When the sketch is full the
+    lowest level at its capacity is sorted and every other value
+    (alternating which half) moves up a level. Sketches of different
+    sensors, threads or nodes merge by adding their levels, so cohort
+    percentiles never need the raw beats.
+******************************************************************************/
+
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef QUANTILE_SKETCH_K
+#define QUANTILE_SKETCH_K 128 // top level capacity, at most 4096, rank error is about 1% at 128 and 0.4% at 400
+#endif
+#define QUANTILE_SKETCH_LEVELS 24 // exact up to K values, holds about K * 2^LEVELS values
+#define QUANTILE_SKETCH_CAPACITY (3 * QUANTILE_SKETCH_K + 2 * QUANTILE_SKETCH_LEVELS) // every level at capacity, ~1.7 KB of values at K 128
+
+typedef struct {
+    uint64_t count; // values added
+    float min; // smallest value added
+    float max; // largest value added
+    float items[QUANTILE_SKETCH_CAPACITY]; // free space, then level 0, level 1... up to the end
+    uint16_t levels[QUANTILE_SKETCH_LEVELS + 1]; // first item of each level, levels[num_levels] is the end
+    uint8_t num_levels; // levels in use, 1 after init
+    uint16_t capacity; // values the levels in use hold before one is compacted
+    uint32_t parity; // bit l picks which half of level l moves up next, flipped every compaction
+}quantile_sketch_t;
+
+/*
+    @brief quantile sketch initialization
+    @param Sketch Pointer to quantile sketch handler
+    @retval None
+*/
+void quantile_sketch_init(quantile_sketch_t * Sketch);
+
+/*
+    @brief adds a value
+    @note e.g. 60000 / IBI of every accepted beat, amortized O(1)
+    @param Sketch Pointer to quantile sketch handler
+    @param value value to add
+    @retval None
+*/
+void quantile_sketch_add(quantile_sketch_t * Sketch, float value);
+
+/*
+    @brief adds all values of another sketch
+    @param Sketch Pointer to quantile sketch handler that receives the values
+    @param Other Pointer to quantile sketch handler to merge, left unchanged
+    @retval None
+*/
+void quantile_sketch_merge(quantile_sketch_t * Sketch, const quantile_sketch_t * Other);
+
+/*
+    @brief estimates a quantile
+    @note sorts the levels in place, O(K * LEVELS)
+    @param Sketch Pointer to quantile sketch handler
+    @param q quantile 0-1, e.g. 0.95 for p95
+    @retval value, 0 if the sketch is empty
+*/
+float quantile_sketch_quantile(quantile_sketch_t * Sketch, float q);
+
+/*
+    @brief estimates the share of added values at or below value
+    @param Sketch Pointer to quantile sketch handler
+    @param value value to rank
+    @retval rank 0-1, 0 if the sketch is empty
+*/
+float quantile_sketch_rank(const quantile_sketch_t * Sketch, float value);
+
+/*
+    @brief get the number of values added
+    @param Sketch Pointer to quantile sketch handler
+    @retval count value
+*/
+uint64_t quantile_sketch_count(const quantile_sketch_t * Sketch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUANTILE_SKETCH_H
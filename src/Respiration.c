@@ -0,0 +1,184 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Respiration
+
+  @File Name
+    Respiration.c
+
+  @Summary
+    Respiratory rate from per beat amplitude, baseline and IBI modulation
+
+  @Description
+    Implements functions that detrend each per beat series with a running
+    mean, count upward crossings with hysteresis as breaths and take the
+    median of the channel rates, so one channel swamped by motion or a
+    weak modulation does not move the result.
+******************************************************************************/
+
+#include "Respiration.h"
+
+static void channel_reset(respiration_channel_t * ch) {
+    ch->rate = 0;
+    ch->period = 0;
+    ch->mean = 0;
+    ch->deviation = 0;
+    ch->prev = 0;
+    ch->prev_time = 0;
+    ch->last_cross = 0;
+    ch->beats = 0;
+    ch->high = false;
+}
+
+static void channel_add(respiration_channel_t * ch, uint64_t time, float value) {
+    if(ch->beats == 0) {
+        ch->mean = value;
+    }
+    float d = value - ch->mean;
+    ch->mean += d / (1 << RESPIRATION_SHIFT);
+    ch->deviation += ((d < 0 ? -d : d) - ch->deviation) / (1 << RESPIRATION_SHIFT);
+
+    if(ch->last_cross != 0 && time - ch->last_cross > RESPIRATION_MAX_PERIOD) {
+        ch->rate = 0; // no breath for too long, the rate is stale
+    }
+
+    if(ch->beats < RESPIRATION_WARMUP) {
+        ch->beats++; // let the mean and deviation settle
+        ch->high = d > 0;
+    }
+    else {
+        float hysteresis = RESPIRATION_HYSTERESIS * ch->deviation;
+        if(!ch->high && d > hysteresis) {
+            ch->high = true;
+            // interpolate the time the series crossed its mean, beats are far apart next to a breath
+            uint64_t cross = time;
+            if(ch->prev < 0) {
+                cross = ch->prev_time + (uint64_t)((float)(time - ch->prev_time) * -ch->prev / (d - ch->prev));
+            }
+            if(ch->last_cross != 0) {
+                uint64_t period = cross - ch->last_cross;
+                if(period >= RESPIRATION_MIN_PERIOD && period <= RESPIRATION_MAX_PERIOD) {
+                    ch->period = (ch->rate == 0) ? (float)period : ch->period + ((float)period - ch->period) / 2;
+                    ch->rate = 60000.0f / ch->period;
+                }
+            }
+            ch->last_cross = cross;
+        }
+        else if(ch->high && d < -hysteresis) {
+            ch->high = false;
+        }
+    }
+
+    ch->prev = d;
+    ch->prev_time = time;
+}
+
+/*
+    @brief respiration stage initialization
+    @param Respiration Pointer to respiration handler
+    @retval None
+*/
+void respiration_init(respiration_t * R) {
+    respiration_reset(R);
+    R->pulse = false;
+    R->skip = true;
+    R->reset_count = 0;
+}
+
+/*
+    @brief starts counting breaths over, e.g. after a pulse sensor reset
+    @param Respiration Pointer to respiration handler
+    @retval None
+*/
+void respiration_reset(respiration_t * R) {
+    R->rate = 0;
+    for(uint8_t i = 0; i < RESPIRATION_CHANNELS; i++) {
+        channel_reset(&R->channel[i]);
+    }
+}
+
+/*
+    @brief adds the modulated values of one beat
+    @param Respiration Pointer to respiration handler
+    @param time beat time (ms)
+    @param amplitude pulse amplitude of the beat
+    @param baseline trough before the beat
+    @param IBI interval before the beat (ms)
+    @retval None
+*/
+void respiration_add_beat(respiration_t * R, uint64_t time, float amplitude, float baseline, uint32_t IBI) {
+    channel_add(&R->channel[RESPIRATION_AMPLITUDE], time, amplitude);
+    channel_add(&R->channel[RESPIRATION_BASELINE], time, baseline);
+    channel_add(&R->channel[RESPIRATION_IBI], time, (float)IBI);
+
+    // median of the channels that have a rate
+    float rates[RESPIRATION_CHANNELS];
+    uint8_t n = 0;
+    for(uint8_t i = 0; i < RESPIRATION_CHANNELS; i++) {
+        float rate = R->channel[i].rate;
+        if(rate == 0) {
+            continue;
+        }
+        uint8_t j = n++;
+        for(; j > 0 && rates[j-1] > rate; j--) { // insertion sort
+            rates[j] = rates[j-1];
+        }
+        rates[j] = rate;
+    }
+    if(n == 0) {
+        R->rate = 0;
+    }
+    else if(n % 2 == 1) {
+        R->rate = rates[n / 2];
+    }
+    else {
+        R->rate = (rates[n / 2 - 1] + rates[n / 2]) / 2;
+    }
+}
+
+/*
+    @brief adds a beat when the pulse sensor finishes one
+    @note call right after pulse_sensor_process_sample(), O(1) and no work unless a beat ended or the sensor reset
+    @param Respiration Pointer to respiration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void respiration_update(respiration_t * R, pulse_sensor_t * PS) {
+    if(PS->reset_count != R->reset_count) {
+        R->reset_count = PS->reset_count;
+        R->pulse = PS->pulse;
+        R->skip = true;
+        respiration_reset(R);
+        return;
+    }
+
+    bool ended = R->pulse && !PS->pulse;
+    R->pulse = PS->pulse;
+    if(!ended) {
+        return;
+    }
+    if(R->skip) {
+        R->skip = false;
+        return;
+    }
+    // amplitude was just measured and thresh set to its middle, the trough was reset already
+    float baseline = PS->thresh - PS->amplitude / 2;
+    respiration_add_beat(R, PS->last_beat_time, PS->amplitude, baseline, PS->IBI);
+}
+
+/*
+    @brief get the fused respiratory rate
+    @param Respiration Pointer to respiration handler
+    @retval rate value (breaths per minute), median of the channels that have a rate, 0 if none has
+*/
+float get_respiratory_rate(respiration_t * R) {
+    return R->rate;
+}
+
+/*
+    @brief get the respiratory rate of one channel
+    @param Respiration Pointer to respiration handler
+    @param channel RESPIRATION_AMPLITUDE, RESPIRATION_BASELINE or RESPIRATION_IBI
+    @retval rate value (breaths per minute), 0 if not known
+*/
+float get_respiratory_rate_channel(respiration_t * R, respiration_channel_id_t channel) {
+    return R->channel[channel].rate;
+}
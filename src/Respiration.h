@@ -0,0 +1,115 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Respiration
+
+  @File Name
+    Respiration.h
+
+  @Summary
+    Respiratory rate from per beat amplitude, baseline and IBI modulation
+
+  @Description
+    Defines functions for a stage that takes one value per beat of pulse
+    amplitude, baseline (trough) and IBI, all of which breathing modulates,
+    counts breaths on each and fuses the three rates. It runs once per beat,
+    not per sample, so it adds no filter chain over the raw signal.
+******************************************************************************/
+
+#ifndef RESPIRATION_H
+#define RESPIRATION_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESPIRATION_SHIFT 3 // beats the detrending mean and deviation follow, as 1 << shift
+#define RESPIRATION_WARMUP 4 // beats before a channel counts breaths
+#define RESPIRATION_HYSTERESIS 0.5f // share of deviation a channel must swing past its mean
+#define RESPIRATION_MIN_PERIOD 1500 // shortest breath (ms), 40 breaths per minute
+#define RESPIRATION_MAX_PERIOD 15000 // longest breath (ms), 4 breaths per minute, older rates go stale
+
+typedef enum {
+    RESPIRATION_AMPLITUDE, // respiratory induced amplitude variation
+    RESPIRATION_BASELINE, // respiratory induced intensity variation
+    RESPIRATION_IBI, // respiratory sinus arrhythmia
+    RESPIRATION_CHANNELS
+}respiration_channel_id_t;
+
+typedef struct {
+    float rate; // breaths per minute, 0 if not known
+    float period; // smoothed breath period (ms)
+    float mean; // detrending mean
+    float deviation; // mean absolute deviation from mean
+    float prev; // previous value minus mean
+    uint64_t prev_time;
+    uint64_t last_cross; // time of the last upward crossing, 0 if none
+    uint8_t beats; // beats since the channel started, up to RESPIRATION_WARMUP
+    bool high; // above the mean by the hysteresis
+}respiration_channel_t;
+
+typedef struct {
+    // respiration output variables
+    float rate; // fused respiratory rate (breaths per minute), 0 if not known
+
+    // respiration internal variables
+    respiration_channel_t channel[RESPIRATION_CHANNELS];
+    bool pulse; // pulse flag seen, a fall is the end of a beat
+    bool skip; // next beat end follows a reset, its amplitude is not real
+    uint32_t reset_count; // reset_count seen, a change is a reset
+}respiration_t;
+
+/*
+    @brief respiration stage initialization
+    @param Respiration Pointer to respiration handler
+    @retval None
+*/
+void respiration_init(respiration_t * Respiration);
+
+/*
+    @brief adds the modulated values of one beat
+    @param Respiration Pointer to respiration handler
+    @param time beat time (ms)
+    @param amplitude pulse amplitude of the beat
+    @param baseline trough before the beat
+    @param IBI interval before the beat (ms)
+    @retval None
+*/
+void respiration_add_beat(respiration_t * Respiration, uint64_t time, float amplitude, float baseline, uint32_t IBI);
+
+/*
+    @brief starts counting breaths over, e.g. after a pulse sensor reset
+    @param Respiration Pointer to respiration handler
+    @retval None
+*/
+void respiration_reset(respiration_t * Respiration);
+
+/*
+    @brief adds a beat when the pulse sensor finishes one
+    @note call right after pulse_sensor_process_sample(), O(1) and no work unless a beat ended or the sensor reset
+    @param Respiration Pointer to respiration handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void respiration_update(respiration_t * Respiration, pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief get the fused respiratory rate
+    @param Respiration Pointer to respiration handler
+    @retval rate value (breaths per minute), median of the channels that have a rate, 0 if none has
+*/
+float get_respiratory_rate(respiration_t * Respiration);
+
+/*
+    @brief get the respiratory rate of one channel
+    @param Respiration Pointer to respiration handler
+    @param channel RESPIRATION_AMPLITUDE, RESPIRATION_BASELINE or RESPIRATION_IBI
+    @retval rate value (breaths per minute), 0 if not known
+*/
+float get_respiratory_rate_channel(respiration_t * Respiration, respiration_channel_id_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RESPIRATION_H
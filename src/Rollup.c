@@ -0,0 +1,240 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor BPM Rollups
+
+  @File Name
+    Rollup.c
+
+  @Summary
+    Per minute, hour and day BPM summaries kept in fixed memory
+
+  @Description
+    Implements functions that update the newest bucket of each tier per
+    beat and merge buckets for queries
+******************************************************************************/
+
+#include "Rollup.h"
+#include <string.h>
+
+static const uint32_t tier_period_ms[ROLLUP_TIERS] = {
+    60000UL, // minute
+    3600000UL, // hour
+    86400000UL // day
+};
+
+static uint8_t histogram_bin(uint8_t bpm) {
+    if(bpm < ROLLUP_HISTOGRAM_MIN_BPM) {
+        return 0;
+    }
+    uint16_t bin = (bpm - ROLLUP_HISTOGRAM_MIN_BPM) / ROLLUP_HISTOGRAM_BIN_BPM;
+    return bin < ROLLUP_HISTOGRAM_BINS ? (uint8_t)bin : ROLLUP_HISTOGRAM_BINS - 1;
+}
+
+static void clear_bucket(rollup_bucket_t * bucket, uint64_t start) {
+    memset(bucket, 0, sizeof(rollup_bucket_t));
+    bucket->start = start;
+    bucket->min = 255;
+}
+
+static void merge_bucket(rollup_bucket_t * into, const rollup_bucket_t * bucket) {
+    if(bucket->count == 0) {
+        return;
+    }
+    into->count += bucket->count;
+    into->sum += bucket->sum;
+    if(bucket->min < into->min) {
+        into->min = bucket->min;
+    }
+    if(bucket->max > into->max) {
+        into->max = bucket->max;
+    }
+    for(uint8_t i = 0; i < ROLLUP_HISTOGRAM_BINS; i++) {
+        into->histogram[i] += bucket->histogram[i];
+    }
+}
+
+static rollup_bucket_t * tier_bucket(rollup_tier_t * tier, uint16_t i) {
+    return &tier->buckets[(tier->oldest + i) % tier->capacity];
+}
+
+/*
+    @brief rollup initialization, all tiers off
+    @param Rollup Pointer to rollup handler
+    @retval None
+*/
+void rollup_init(rollup_t * Rollup) {
+    for(uint8_t i = 0; i < ROLLUP_TIERS; i++) {
+        rollup_set_tier(Rollup, (rollup_tier_id_t)i, NULL, 0);
+    }
+}
+
+/*
+    @brief gives a tier its buckets
+    @note e.g. 60 minutes, 48 hours and 30 days, older buckets are overwritten
+    @param Rollup Pointer to rollup handler
+    @param tier ROLLUP_MINUTE, ROLLUP_HOUR or ROLLUP_DAY
+    @param buckets bucket storage
+    @param capacity number of buckets, 0 to turn the tier off
+    @retval None
+*/
+void rollup_set_tier(rollup_t * Rollup, rollup_tier_id_t tier, rollup_bucket_t * buckets, uint16_t capacity) {
+    rollup_tier_t * t = &Rollup->tiers[tier];
+    t->buckets = buckets;
+    t->capacity = buckets == NULL ? 0 : capacity;
+    t->oldest = 0;
+    t->count = 0;
+    t->period_ms = tier_period_ms[tier];
+}
+
+/*
+    @brief adds an accepted beat to every tier
+    @note O(tiers), call when take_start_of_beat() returns true
+    @param Rollup Pointer to rollup handler
+    @param time beat time (ms), e.g. last_beat_time plus a wall clock base
+    @param bpm BPM after the beat, 0 is ignored
+    @retval false if the beat was older than the current bucket of a tier and not added there
+*/
+bool rollup_add_beat(rollup_t * Rollup, uint64_t time, uint8_t bpm) {
+    if(bpm == 0) {
+        return true; // no BPM yet
+    }
+
+    bool added = true;
+    uint8_t bin = histogram_bin(bpm);
+
+    for(uint8_t i = 0; i < ROLLUP_TIERS; i++) {
+        rollup_tier_t * tier = &Rollup->tiers[i];
+        if(tier->capacity == 0) {
+            continue;
+        }
+
+        uint64_t start = time - time % tier->period_ms;
+        rollup_bucket_t * current = tier->count > 0 ? tier_bucket(tier, tier->count - 1) : NULL;
+        if(current != NULL && start < current->start) {
+            added = false; // older than the current bucket
+            continue;
+        }
+        if(current == NULL || start != current->start) {
+            if(tier->count == tier->capacity) {
+                tier->oldest = (tier->oldest + 1) % tier->capacity; // retention reached, drop the oldest
+            }
+            else {
+                tier->count++;
+            }
+            current = tier_bucket(tier, tier->count - 1);
+            clear_bucket(current, start);
+        }
+
+        current->count++;
+        current->sum += bpm;
+        if(bpm < current->min) {
+            current->min = bpm;
+        }
+        if(bpm > current->max) {
+            current->max = bpm;
+        }
+        current->histogram[bin]++;
+    }
+
+    return added;
+}
+
+/*
+    @brief get the number of buckets kept by a tier
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @retval bucket count
+*/
+uint16_t rollup_get_bucket_count(rollup_t * Rollup, rollup_tier_id_t tier) {
+    return Rollup->tiers[tier].count;
+}
+
+/*
+    @brief get a bucket of a tier
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @param i 0 for the oldest bucket, rollup_get_bucket_count() - 1 for the current one
+    @retval bucket, NULL if i is out of range
+*/
+const rollup_bucket_t * rollup_get_bucket(rollup_t * Rollup, rollup_tier_id_t tier, uint16_t i) {
+    rollup_tier_t * t = &Rollup->tiers[tier];
+    return i < t->count ? tier_bucket(t, i) : NULL;
+}
+
+/*
+    @brief merges the buckets of a tier that start in [from, to)
+    @note O(buckets), pick the coarsest tier that still covers the range
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @param from start of the range (ms)
+    @param to end of the range (ms)
+    @param summary merged bucket, start is the first merged bucket's start
+    @retval number of buckets merged
+*/
+uint16_t rollup_query(rollup_t * Rollup, rollup_tier_id_t tier, uint64_t from, uint64_t to, rollup_bucket_t * summary) {
+    rollup_tier_t * t = &Rollup->tiers[tier];
+    uint16_t merged = 0;
+
+    clear_bucket(summary, 0);
+    for(uint16_t i = 0; i < t->count; i++) {
+        const rollup_bucket_t * bucket = tier_bucket(t, i);
+        if(bucket->start < from || bucket->start >= to) {
+            continue;
+        }
+        if(merged == 0) {
+            summary->start = bucket->start;
+        }
+        merge_bucket(summary, bucket);
+        merged++;
+    }
+
+    return merged;
+}
+
+/*
+    @brief get the mean BPM of a bucket
+    @param bucket bucket or merged summary
+    @retval mean BPM, 0 without beats
+*/
+float rollup_mean(const rollup_bucket_t * bucket) {
+    return bucket->count == 0 ? 0 : (float)bucket->sum / bucket->count;
+}
+
+/*
+    @brief estimates a BPM percentile from a bucket histogram
+    @note interpolates inside the bin, clamped to the bucket min and max
+    @param bucket bucket or merged summary
+    @param percentile 0-100
+    @retval BPM, 0 without beats
+*/
+float rollup_percentile(const rollup_bucket_t * bucket, float percentile) {
+    if(bucket->count == 0) {
+        return 0;
+    }
+    if(percentile < 0) {
+        percentile = 0;
+    }
+    if(percentile > 100) {
+        percentile = 100;
+    }
+
+    float target = percentile / 100.0f * bucket->count;
+    uint32_t below = 0;
+    float bpm = bucket->max;
+    for(uint8_t i = 0; i < ROLLUP_HISTOGRAM_BINS; i++) {
+        uint32_t in_bin = bucket->histogram[i];
+        if(in_bin > 0 && below + in_bin >= target) {
+            float low = ROLLUP_HISTOGRAM_MIN_BPM + (float)i * ROLLUP_HISTOGRAM_BIN_BPM;
+            bpm = low + (target - below) / in_bin * ROLLUP_HISTOGRAM_BIN_BPM;
+            break;
+        }
+        below += in_bin;
+    }
+
+    if(bpm < bucket->min) {
+        bpm = bucket->min;
+    }
+    if(bpm > bucket->max) {
+        bpm = bucket->max;
+    }
+    return bpm;
+}
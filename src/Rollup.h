@@ -0,0 +1,135 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor BPM Rollups
+
+  @File Name
+    Rollup.h
+
+  @Summary
+    Per minute, hour and day BPM summaries kept in fixed memory
+
+  @Description
+    Defines functions that add every accepted beat to the current minute,
+    hour and day bucket (count, min, max, sum and a BPM histogram). Each tier
+    is a ring of caller provided buckets, so retention is set per tier and
+    memory never grows. Trend queries merge buckets instead of scanning beats.
+******************************************************************************/
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROLLUP_HISTOGRAM_BINS 24
+#define ROLLUP_HISTOGRAM_MIN_BPM 30 // first bin starts here, lower BPM are counted in the first bin
+#define ROLLUP_HISTOGRAM_BIN_BPM 8 // BPM per bin, last bin ends at 222 and counts everything above
+
+typedef enum {
+    ROLLUP_MINUTE,
+    ROLLUP_HOUR,
+    ROLLUP_DAY,
+    ROLLUP_TIERS
+}rollup_tier_id_t;
+
+typedef struct {
+    uint64_t start; // start time of the bucket (ms), multiple of the tier period
+    uint64_t sum; // sum of BPM, mean is sum / count, 64 bits so merged ranges of any length cannot overflow
+    uint32_t count; // beats in the bucket
+    uint8_t min;
+    uint8_t max;
+    uint32_t histogram[ROLLUP_HISTOGRAM_BINS]; // beats per BPM bin, for percentiles
+}rollup_bucket_t;
+
+typedef struct {
+    rollup_bucket_t * buckets; // ring of buckets, caller provided
+    uint16_t capacity; // retention in buckets, 0 to turn the tier off
+    uint16_t oldest; // ring index of the oldest bucket
+    uint16_t count; // buckets in use
+    uint32_t period_ms;
+}rollup_tier_t;
+
+typedef struct {
+    rollup_tier_t tiers[ROLLUP_TIERS];
+}rollup_t;
+
+/*
+    @brief rollup initialization, all tiers off
+    @param Rollup Pointer to rollup handler
+    @retval None
+*/
+void rollup_init(rollup_t * Rollup);
+
+/*
+    @brief gives a tier its buckets
+    @note e.g. 60 minutes, 48 hours and 30 days, older buckets are overwritten
+    @param Rollup Pointer to rollup handler
+    @param tier ROLLUP_MINUTE, ROLLUP_HOUR or ROLLUP_DAY
+    @param buckets bucket storage
+    @param capacity number of buckets, 0 to turn the tier off
+    @retval None
+*/
+void rollup_set_tier(rollup_t * Rollup, rollup_tier_id_t tier, rollup_bucket_t * buckets, uint16_t capacity);
+
+/*
+    @brief adds an accepted beat to every tier
+    @note O(tiers), call when take_start_of_beat() returns true
+    @param Rollup Pointer to rollup handler
+    @param time beat time (ms), e.g. last_beat_time plus a wall clock base
+    @param bpm BPM after the beat, 0 is ignored
+    @retval false if the beat was older than the current bucket of a tier and not added there
+*/
+bool rollup_add_beat(rollup_t * Rollup, uint64_t time, uint8_t bpm);
+
+/*
+    @brief get the number of buckets kept by a tier
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @retval bucket count
+*/
+uint16_t rollup_get_bucket_count(rollup_t * Rollup, rollup_tier_id_t tier);
+
+/*
+    @brief get a bucket of a tier
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @param i 0 for the oldest bucket, rollup_get_bucket_count() - 1 for the current one
+    @retval bucket, NULL if i is out of range
+*/
+const rollup_bucket_t * rollup_get_bucket(rollup_t * Rollup, rollup_tier_id_t tier, uint16_t i);
+
+/*
+    @brief merges the buckets of a tier that start in [from, to)
+    @note O(buckets), pick the coarsest tier that still covers the range
+    @param Rollup Pointer to rollup handler
+    @param tier tier id
+    @param from start of the range (ms)
+    @param to end of the range (ms)
+    @param summary merged bucket, start is the first merged bucket's start
+    @retval number of buckets merged
+*/
+uint16_t rollup_query(rollup_t * Rollup, rollup_tier_id_t tier, uint64_t from, uint64_t to, rollup_bucket_t * summary);
+
+/*
+    @brief get the mean BPM of a bucket
+    @param bucket bucket or merged summary
+    @retval mean BPM, 0 without beats
+*/
+float rollup_mean(const rollup_bucket_t * bucket);
+
+/*
+    @brief estimates a BPM percentile from a bucket histogram
+    @note interpolates inside the bin, clamped to the bucket min and max
+    @param bucket bucket or merged summary
+    @param percentile 0-100
+    @retval BPM, 0 without beats
+*/
+float rollup_percentile(const rollup_bucket_t * bucket, float percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ROLLUP_H
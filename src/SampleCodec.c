@@ -0,0 +1,441 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Sample Codec
+
+  @File Name
+    SampleCodec.c
+
+  @Summary
+    Lossless compression of raw ADC sample streams
+
+  @Description
+    Implements the block codec. Decoding is split in two passes: unpacking
+    the residuals and undoing the prediction. Fixed width fields (bit
+    packed residuals, Rice remainders) unpack with no branches on the data;
+    built with AVX2 (-mavx2 or -march=native on x86) the unpack gathers,
+    shifts and zigzag decodes 8 fields per instruction, other targets
+    unpack one field per 64 bit load. Rice quotients are read from 57 bit
+    windows with one count trailing zeros per quotient, which is the
+    serial part that makes Rice blocks slower to decode.
+******************************************************************************/
+
+#include "SampleCodec.h"
+#include "BitPack.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define WIDTH_MASK 0x1F
+#define PREDICTOR_SHIFT 5
+#define PREDICTOR_MASK 0x3
+#define RICE_FLAG 0x80
+#define RICE_ESCAPE 16 // quotients from here on are sent as RICE_ESCAPE in unary and in full after the unary part
+#define PAD_BYTES 8 // readable bytes past the last group of 8 fields, so every field is one load
+#define MAX_REACH (((SAMPLE_CODEC_BLOCK - 1) * (SAMPLE_CODEC_MAX_WIDTH + RICE_ESCAPE + 1) + 7) / 8 + PAD_BYTES) // bytes the unpack loads may touch
+
+// residuals of samples 1..count-1 for a predictor
+static void predict(const int16_t * samples, uint8_t count, sample_codec_predictor_t predictor, uint32_t * residuals) {
+    residuals[0] = zigzag_encode((int32_t)samples[1] - samples[0]);
+    for(uint8_t i = 2; i < count; i++) {
+        int32_t prediction = predictor == SAMPLE_CODEC_DELTA ? samples[i-1] : 2 * (int32_t)samples[i-1] - samples[i-2];
+        residuals[i-1] = zigzag_encode((int32_t)samples[i] - prediction);
+    }
+}
+
+static uint8_t residual_width(const uint32_t * residuals, uint8_t count) {
+    uint32_t all = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        all |= residuals[i];
+    }
+    return bit_width(all);
+}
+
+// bits to Rice code residuals with parameter k
+static uint32_t rice_bits(const uint32_t * residuals, uint8_t count, uint8_t k) {
+    uint32_t bits = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t q = residuals[i] >> k;
+        bits += k + (q < RICE_ESCAPE ? q + 1 : RICE_ESCAPE + 1 + SAMPLE_CODEC_MAX_WIDTH);
+    }
+    return bits;
+}
+
+// Rice parameter with the fewest bits, k at or above width never beats packing
+static uint8_t rice_parameter(const uint32_t * residuals, uint8_t count, uint8_t width, uint32_t * bits) {
+    uint8_t best = 0;
+    *bits = rice_bits(residuals, count, 0);
+    for(uint8_t k = 1; k < width; k++) {
+        uint32_t b = rice_bits(residuals, count, k);
+        if(b < *bits) {
+            best = k;
+            *bits = b;
+        }
+    }
+    return best;
+}
+
+// low k bits of every residual, then every quotient as q zero bits and a one bit, then the
+// quotients of RICE_ESCAPE or more in SAMPLE_CODEC_MAX_WIDTH bits
+static void rice_write(bit_writer_t * Writer, const uint32_t * residuals, uint8_t count, uint8_t k) {
+    for(uint8_t i = 0; i < count; i++) {
+        bit_write(Writer, residuals[i], k);
+    }
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t q = residuals[i] >> k;
+        q = q < RICE_ESCAPE ? q : RICE_ESCAPE;
+        bit_write(Writer, (uint32_t)1 << q, (uint8_t)(q + 1));
+    }
+    for(uint8_t i = 0; i < count; i++) {
+        if(residuals[i] >> k >= RICE_ESCAPE) {
+            bit_write(Writer, residuals[i] >> k, SAMPLE_CODEC_MAX_WIDTH);
+        }
+    }
+}
+
+static uint8_t trailing_zeros(uint64_t value) {
+#if defined(__GNUC__)
+    return (uint8_t)__builtin_ctzll(value);
+#else
+    uint8_t count = 0;
+    while(!(value & 1)) {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static uint64_t load_le64(const uint8_t * p) {
+    return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+           (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+// reads count unary quotients starting at bit, every one bit of a 57 bit window ends a quotient,
+// sets longest to the longest, returns the bit after the last one or 0 if one is too long
+static size_t unary_unpack(const uint8_t * p, size_t bit, uint32_t count, uint32_t * quotients, uint32_t * longest) {
+    uint32_t i = 0;
+    uint32_t max = 0;
+    while(i < count) {
+        uint64_t window = (load_le64(p + (bit >> 3)) >> (bit & 7)) & (((uint64_t)1 << 57) - 1);
+        if(window == 0) {
+            return 0;
+        }
+        uint32_t start = 0; // window bit the next quotient starts at
+        do {
+            uint32_t end = trailing_zeros(window);
+            uint32_t q = end - start;
+            quotients[i++] = q;
+            max = q > max ? q : max;
+            start = end + 1;
+            window &= window - 1; // clear the lowest one bit
+        } while(window != 0 && i < count);
+        if(max > RICE_ESCAPE) {
+            return 0;
+        }
+        bit += start;
+    }
+    *longest = max;
+    return bit;
+}
+
+#if defined(__AVX2__)
+// unpacks count fields in groups of 8, puts high (if any) above them and zigzag decodes, each lane
+// gathers the 4 bytes holding its field
+static void unpack(const uint8_t * p, uint32_t width, uint32_t count, const uint32_t * high, int32_t * values) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i field_width = _mm256_set1_epi32((int)width);
+    const __m256i mask = _mm256_set1_epi32((int)(((uint32_t)1 << width) - 1));
+    const __m256i seven = _mm256_set1_epi32(7);
+    const __m256i one = _mm256_set1_epi32(1);
+    for(uint32_t i = 0; i < count; i += 8) {
+        __m256i bit = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32((int)i), lane), field_width);
+        __m256i word = _mm256_i32gather_epi32((const int *)p, _mm256_srli_epi32(bit, 3), 1);
+        __m256i v = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(bit, seven)), mask);
+        if(high != NULL) {
+            v = _mm256_or_si256(v, _mm256_sllv_epi32(_mm256_loadu_si256((const __m256i *)(high + i)), field_width));
+        }
+        v = _mm256_xor_si256(_mm256_srli_epi32(v, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(v, one))); // (v >> 1) ^ -(v & 1)
+        _mm256_storeu_si256((__m256i *)(values + i), v);
+    }
+}
+#else
+// unpacks count fields, puts high (if any) above them and zigzag decodes, every field is a shift
+// and mask of one 64 bit load
+static void unpack(const uint8_t * p, uint32_t width, uint32_t count, const uint32_t * high, int32_t * values) {
+    uint64_t mask = ((uint64_t)1 << width) - 1;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t bit = i * width;
+        uint32_t v = (uint32_t)((load_le64(p + (bit >> 3)) >> (bit & 7)) & mask);
+        if(high != NULL) {
+            v |= high[i] << width;
+        }
+        values[i] = zigzag_decode(v);
+    }
+}
+#endif
+
+/*
+    @brief codes one block of samples
+    @param samples raw ADC samples
+    @param count number of samples, 1-SAMPLE_CODEC_BLOCK
+    @param output destination, SAMPLE_CODEC_MAX_BLOCK_BYTES is always enough
+    @param size size of output (bytes)
+    @retval bytes written, 0 if count is out of range or output is too small
+*/
+size_t sample_codec_encode_block(const int16_t * samples, uint8_t count, uint8_t * output, size_t size) {
+    if(count == 0 || count > SAMPLE_CODEC_BLOCK || size < SAMPLE_CODEC_HEADER) {
+        return 0;
+    }
+
+    uint32_t delta[SAMPLE_CODEC_BLOCK - 1];
+    uint32_t second[SAMPLE_CODEC_BLOCK - 1];
+    uint8_t residuals = count - 1;
+    sample_codec_predictor_t predictor = SAMPLE_CODEC_DELTA;
+    uint8_t width = 0; // residual width, or the Rice parameter when rice is set
+    bool rice = false;
+    const uint32_t * chosen = delta;
+
+    if(residuals > 0) {
+        predict(samples, count, SAMPLE_CODEC_DELTA, delta);
+        predict(samples, count, SAMPLE_CODEC_SECOND_ORDER, second);
+
+        // fewest bits out of both predictors, bit packed or Rice coded
+        uint32_t best = UINT32_MAX;
+        for(uint8_t p = SAMPLE_CODEC_DELTA; p <= SAMPLE_CODEC_SECOND_ORDER; p++) {
+            const uint32_t * r = p == SAMPLE_CODEC_DELTA ? delta : second;
+            uint8_t w = residual_width(r, residuals);
+            uint32_t rice_size;
+            uint8_t k = rice_parameter(r, residuals, w, &rice_size);
+            if((uint32_t)residuals * w < best) {
+                best = (uint32_t)residuals * w;
+                predictor = (sample_codec_predictor_t)p;
+                width = w;
+                rice = false;
+                chosen = r;
+            }
+            if(SAMPLE_CODEC_RICE && rice_size < best) {
+                best = rice_size;
+                predictor = (sample_codec_predictor_t)p;
+                width = k;
+                rice = true;
+                chosen = r;
+            }
+        }
+    }
+
+    output[0] = (uint8_t)(width | (predictor << PREDICTOR_SHIFT) | (rice ? RICE_FLAG : 0));
+    output[1] = count;
+    output[2] = (uint8_t)((uint16_t)samples[0]);
+    output[3] = (uint8_t)((uint16_t)samples[0] >> 8);
+
+    bit_writer_t writer;
+    bit_writer_init(&writer, output + SAMPLE_CODEC_HEADER, size - SAMPLE_CODEC_HEADER);
+    if(rice) {
+        rice_write(&writer, chosen, residuals, width);
+    }
+    else {
+        for(uint8_t i = 0; i < residuals; i++) {
+            bit_write(&writer, chosen[i], width);
+        }
+    }
+    if(residuals == 0 || (width == 0 && !rice)) {
+        return SAMPLE_CODEC_HEADER; // no residual bits
+    }
+    size_t bytes = bit_writer_flush(&writer);
+    return bytes == 0 ? 0 : SAMPLE_CODEC_HEADER + bytes;
+}
+
+/*
+    @brief decodes one block of samples
+    @param input coded block
+    @param size bytes available in input, may hold more blocks
+    @param samples destination, room for SAMPLE_CODEC_BLOCK samples
+    @param count set to the number of samples decoded
+    @retval bytes used by the block, 0 if input does not start with a valid block
+*/
+size_t sample_codec_decode_block(const uint8_t * input, size_t size, int16_t * samples, uint8_t * count) {
+    if(size < SAMPLE_CODEC_HEADER) {
+        return 0;
+    }
+    uint8_t width = input[0] & WIDTH_MASK;
+    uint8_t predictor = (input[0] >> PREDICTOR_SHIFT) & PREDICTOR_MASK;
+    bool rice = (input[0] & RICE_FLAG) != 0;
+    uint8_t n = input[1];
+    if(n == 0 || n > SAMPLE_CODEC_BLOCK || width > SAMPLE_CODEC_MAX_WIDTH ||
+       (predictor != SAMPLE_CODEC_DELTA && predictor != SAMPLE_CODEC_SECOND_ORDER)) {
+        return 0;
+    }
+    uint8_t residuals = n - 1;
+
+    // fields are read straight from input when it holds every byte the loads can touch (all but
+    // the last block of a buffer), else from a zero padded copy
+    uint8_t padded[MAX_REACH];
+    const uint8_t * fields = input + SAMPLE_CODEC_HEADER;
+    size_t available = size - SAMPLE_CODEC_HEADER;
+    size_t reach = (size_t)((residuals + 7) & ~7) * width / 8 + PAD_BYTES;
+    size_t rice_reach = ((size_t)residuals * (width + RICE_ESCAPE + 1) + 7) / 8 + PAD_BYTES;
+    if(rice && rice_reach > reach) {
+        reach = rice_reach; // remainders and quotients
+    }
+    if(available < reach) {
+        memcpy(padded, fields, available);
+        memset(padded + available, 0, reach - available);
+        fields = padded;
+    }
+
+    // pass 1: unpack and zigzag
+    int32_t values[SAMPLE_CODEC_BLOCK]; // whole groups of 8
+    uint32_t high[SAMPLE_CODEC_BLOCK] = {0}; // Rice quotients, whole groups of 8
+    size_t payload = ((size_t)residuals * width + 7) / 8;
+    if(rice && residuals > 0) {
+        uint32_t longest;
+        size_t bit = unary_unpack(fields, (size_t)residuals * width, residuals, high, &longest);
+        if(bit == 0) {
+            return 0;
+        }
+        payload = (bit + 7) / 8;
+
+        // quotients of RICE_ESCAPE or more follow in full, these are rare so they are read with
+        // the bounds checked reader straight from input
+        if(longest == RICE_ESCAPE) {
+            bit_reader_t reader;
+            bit_reader_init(&reader, input + SAMPLE_CODEC_HEADER + bit / 8, available - (bit / 8 < available ? bit / 8 : available));
+            bit_read(&reader, (uint8_t)(bit & 7));
+            for(uint8_t i = 0; i < residuals; i++) {
+                if(high[i] == RICE_ESCAPE) {
+                    high[i] = bit_read(&reader, SAMPLE_CODEC_MAX_WIDTH);
+                }
+            }
+            if(reader.overrun) {
+                return 0;
+            }
+            payload = bit / 8 + bit_reader_position(&reader);
+        }
+    }
+    if(available < payload) {
+        return 0;
+    }
+    unpack(fields, width, residuals, rice ? high : NULL, values);
+
+    // pass 2: undo the prediction
+    int32_t previous = (int16_t)((uint16_t)input[2] | (uint16_t)input[3] << 8);
+    samples[0] = (int16_t)previous;
+    if(residuals > 0) {
+        int32_t current = previous + values[0];
+        samples[1] = (int16_t)current;
+        if(predictor == SAMPLE_CODEC_DELTA) {
+            for(uint8_t i = 1; i < residuals; i++) {
+                current += values[i];
+                samples[i+1] = (int16_t)current;
+            }
+        }
+        else {
+            int32_t slope = current - previous;
+            for(uint8_t i = 1; i < residuals; i++) {
+                slope += values[i];
+                current += slope;
+                samples[i+1] = (int16_t)current;
+            }
+        }
+    }
+
+    *count = n;
+    return SAMPLE_CODEC_HEADER + payload;
+}
+
+/*
+    @brief codes a buffer of samples as back to back blocks
+    @param samples raw ADC samples
+    @param count number of samples
+    @param output destination, count / SAMPLE_CODEC_BLOCK + 1 blocks of SAMPLE_CODEC_MAX_BLOCK_BYTES is always enough
+    @param size size of output (bytes)
+    @retval bytes written, 0 if output is too small
+*/
+size_t sample_codec_encode(const int16_t * samples, size_t count, uint8_t * output, size_t size) {
+    size_t written = 0;
+    for(size_t i = 0; i < count; i += SAMPLE_CODEC_BLOCK) {
+        uint8_t n = (uint8_t)(count - i < SAMPLE_CODEC_BLOCK ? count - i : SAMPLE_CODEC_BLOCK);
+        size_t bytes = sample_codec_encode_block(samples + i, n, output + written, size - written);
+        if(bytes == 0) {
+            return 0;
+        }
+        written += bytes;
+    }
+    return written;
+}
+
+/*
+    @brief decodes back to back blocks
+    @param input coded blocks
+    @param size size of input (bytes)
+    @param samples destination
+    @param max_count room in samples
+    @retval number of samples decoded, stops at the first invalid block or when samples is full
+*/
+size_t sample_codec_decode(const uint8_t * input, size_t size, int16_t * samples, size_t max_count) {
+    size_t decoded = 0;
+    size_t pos = 0;
+    int16_t block[SAMPLE_CODEC_BLOCK];
+
+    while(pos < size) {
+        uint8_t n;
+        int16_t * destination = max_count - decoded >= SAMPLE_CODEC_BLOCK ? samples + decoded : block;
+        size_t bytes = sample_codec_decode_block(input + pos, size - pos, destination, &n);
+        if(bytes == 0) {
+            break;
+        }
+        if(destination == block) {
+            if(n > max_count - decoded) {
+                break; // no room for the whole block
+            }
+            memcpy(samples + decoded, block, n * sizeof(int16_t));
+        }
+        decoded += n;
+        pos += bytes;
+    }
+
+    return decoded;
+}
+
+/*
+    @brief streaming encoder initialization
+    @param Encoder Pointer to streaming encoder handler
+    @retval None
+*/
+void sample_encoder_init(sample_encoder_t * Encoder) {
+    Encoder->count = 0;
+}
+
+/*
+    @brief adds a sample, codes the block once it is full
+    @param Encoder Pointer to streaming encoder handler
+    @param sample raw ADC sample
+    @param output destination for a finished block, at least SAMPLE_CODEC_MAX_BLOCK_BYTES
+    @param size size of output (bytes)
+    @retval bytes written to output, 0 while the block is not full yet
+*/
+size_t sample_encoder_add(sample_encoder_t * Encoder, int16_t sample, uint8_t * output, size_t size) {
+    Encoder->block[Encoder->count++] = sample;
+    if(Encoder->count < SAMPLE_CODEC_BLOCK) {
+        return 0;
+    }
+    return sample_encoder_flush(Encoder, output, size);
+}
+
+/*
+    @brief codes the samples of a partial block
+    @note call at the end of a recording
+    @param Encoder Pointer to streaming encoder handler
+    @param output destination, at least SAMPLE_CODEC_MAX_BLOCK_BYTES
+    @param size size of output (bytes)
+    @retval bytes written to output, 0 if there were no samples
+*/
+size_t sample_encoder_flush(sample_encoder_t * Encoder, uint8_t * output, size_t size) {
+    if(Encoder->count == 0) {
+        return 0;
+    }
+    size_t bytes = sample_codec_encode_block(Encoder->block, Encoder->count, output, size);
+    Encoder->count = 0;
+    return bytes;
+}
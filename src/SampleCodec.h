@@ -0,0 +1,131 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Sample Codec
+
+  @File Name
+    SampleCodec.h
+
+  @Summary
+    Lossless compression of raw ADC sample streams
+
+  @Description
+    Defines functions that code blocks of up to SAMPLE_CODEC_BLOCK raw ADC
+    samples as the first sample plus zigzag coded prediction residuals,
+    either bit packed or Rice coded. Each block picks the predictor (delta
+    or second order) and coding that take the fewest bits. Blocks are
+    independent, so a recording can be decoded from any block.
+
+    Block layout:
+        byte 0      bits 0-4 residual width (Rice parameter k), bits 5-6
+                    predictor, bit 7 set for Rice coding
+        byte 1      sample count, 1-SAMPLE_CODEC_BLOCK
+        bytes 2-3   first sample, little endian
+        bytes 4...  count - 1 residuals, least significant bit first
+
+    Bit packed residuals are width bits each. Rice coded residuals are the
+    low k bits of every residual, then every quotient (residual >> k) in
+    unary as that many 0 bits and a 1 bit, then the quotients of
+    16 or more, which are sent as 16 in unary, in full in 19 bits.
+******************************************************************************/
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SAMPLE_CODEC_RICE
+#define SAMPLE_CODEC_RICE 1 // 0 to only write bit packed blocks, they decode faster, both are always decoded
+#endif
+
+#define SAMPLE_CODEC_BLOCK 64 // samples per block
+#define SAMPLE_CODEC_HEADER 4 // bytes in front of the residuals
+#define SAMPLE_CODEC_MAX_WIDTH 19 // widest residual, second order prediction of 16 bit samples
+#define SAMPLE_CODEC_MAX_BLOCK_BYTES (SAMPLE_CODEC_HEADER + ((SAMPLE_CODEC_BLOCK - 1) * SAMPLE_CODEC_MAX_WIDTH + 7) / 8)
+
+typedef enum {
+    SAMPLE_CODEC_DELTA = 1, // residual = x[n] - x[n-1]
+    SAMPLE_CODEC_SECOND_ORDER = 2 // residual = x[n] - 2x[n-1] + x[n-2], second sample uses delta
+}sample_codec_predictor_t;
+
+typedef struct {
+    int16_t block[SAMPLE_CODEC_BLOCK]; // samples waiting for a full block
+    uint8_t count; // samples in block
+}sample_encoder_t;
+
+/*
+    @brief codes one block of samples
+    @param samples raw ADC samples
+    @param count number of samples, 1-SAMPLE_CODEC_BLOCK
+    @param output destination, SAMPLE_CODEC_MAX_BLOCK_BYTES is always enough
+    @param size size of output (bytes)
+    @retval bytes written, 0 if count is out of range or output is too small
+*/
+size_t sample_codec_encode_block(const int16_t * samples, uint8_t count, uint8_t * output, size_t size);
+
+/*
+    @brief decodes one block of samples
+    @param input coded block
+    @param size bytes available in input, may hold more blocks
+    @param samples destination, room for SAMPLE_CODEC_BLOCK samples
+    @param count set to the number of samples decoded
+    @retval bytes used by the block, 0 if input does not start with a valid block
+*/
+size_t sample_codec_decode_block(const uint8_t * input, size_t size, int16_t * samples, uint8_t * count);
+
+/*
+    @brief codes a buffer of samples as back to back blocks
+    @param samples raw ADC samples
+    @param count number of samples
+    @param output destination, count / SAMPLE_CODEC_BLOCK + 1 blocks of SAMPLE_CODEC_MAX_BLOCK_BYTES is always enough
+    @param size size of output (bytes)
+    @retval bytes written, 0 if output is too small
+*/
+size_t sample_codec_encode(const int16_t * samples, size_t count, uint8_t * output, size_t size);
+
+/*
+    @brief decodes back to back blocks
+    @param input coded blocks
+    @param size size of input (bytes)
+    @param samples destination
+    @param max_count room in samples
+    @retval number of samples decoded, stops at the first invalid block or when samples is full
+*/
+size_t sample_codec_decode(const uint8_t * input, size_t size, int16_t * samples, size_t max_count);
+
+/*
+    @brief streaming encoder initialization
+    @param Encoder Pointer to streaming encoder handler
+    @retval None
+*/
+void sample_encoder_init(sample_encoder_t * Encoder);
+
+/*
+    @brief adds a sample, codes the block once it is full
+    @param Encoder Pointer to streaming encoder handler
+    @param sample raw ADC sample
+    @param output destination for a finished block, at least SAMPLE_CODEC_MAX_BLOCK_BYTES
+    @param size size of output (bytes)
+    @retval bytes written to output, 0 while the block is not full yet
+*/
+size_t sample_encoder_add(sample_encoder_t * Encoder, int16_t sample, uint8_t * output, size_t size);
+
+/*
+    @brief codes the samples of a partial block
+    @note call at the end of a recording
+    @param Encoder Pointer to streaming encoder handler
+    @param output destination, at least SAMPLE_CODEC_MAX_BLOCK_BYTES
+    @param size size of output (bytes)
+    @retval bytes written to output, 0 if there were no samples
+*/
+size_t sample_encoder_flush(sample_encoder_t * Encoder, uint8_t * output, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_CODEC_H
@@ -0,0 +1,335 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Sample Ring
+
+  @File Name
+    SampleRing.c
+
+  @Summary
+    Lock-free shared memory ring for passing samples and beat events between processes
+
+  @Description
+    Implements a single producer, single consumer ring of fixed size records
+    in a caller provided memory block. head and tail run freely and wrap at
+    2^32, the producer only writes head and the consumer only writes tail.
+******************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE // memfd_create
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "SampleRing.h"
+#include <string.h>
+
+static bool is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+#ifdef __linux__
+// sleeps while *word == expected, shared futex so it works across processes
+static void futex_wait(_Atomic uint32_t * word, uint32_t expected, int32_t timeout_ms) {
+    struct timespec timeout;
+    struct timespec * timeout_ptr = NULL;
+    if(timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, timeout_ptr, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t * word) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+#endif
+
+/*
+    @brief shared memory needed for a ring
+    @param capacity number of records, power of 2
+    @param record_size bytes per record, e.g. sizeof(pulse_sample_t)
+    @retval bytes
+*/
+size_t sample_ring_memory_size(uint32_t capacity, uint32_t record_size) {
+    return sizeof(sample_ring_header_t) + (size_t)capacity * record_size;
+}
+
+/*
+    @brief formats a memory block as an empty ring and attaches to it
+    @note call once, from the side that creates the shared memory
+    @param Ring Pointer to ring handler
+    @param memory memory block, aligned to SAMPLE_RING_CACHE_LINE (mmap memory is)
+    @param size size of memory (bytes)
+    @param capacity number of records, power of 2
+    @param record_size bytes per record
+    @retval true if the ring fits in memory
+*/
+bool sample_ring_init(sample_ring_t * Ring, void * memory, size_t size, uint32_t capacity, uint32_t record_size) {
+    if(memory == NULL || !is_power_of_two(capacity) || record_size == 0 || size < sample_ring_memory_size(capacity, record_size)) {
+        return false;
+    }
+
+    sample_ring_header_t * header = (sample_ring_header_t *)memory;
+    memset(header, 0, sizeof(sample_ring_header_t));
+    header->capacity = capacity;
+    header->record_size = record_size;
+    header->version = SAMPLE_RING_VERSION;
+    atomic_init(&header->head, 0);
+    atomic_init(&header->tail, 0);
+    atomic_init(&header->consumer_waiting, 0);
+    atomic_init(&header->producer_waiting, 0);
+    // magic last, a consumer attaching early sees an invalid ring instead of a half formatted one
+    atomic_thread_fence(memory_order_release);
+    header->magic = SAMPLE_RING_MAGIC;
+
+    return sample_ring_attach(Ring, memory, size);
+}
+
+/*
+    @brief attaches to a ring formatted by sample_ring_init(), e.g. in the other process
+    @param Ring Pointer to ring handler
+    @param memory memory block holding the ring
+    @param size size of memory (bytes)
+    @retval true if memory holds a valid ring
+*/
+bool sample_ring_attach(sample_ring_t * Ring, void * memory, size_t size) {
+    if(memory == NULL || size < sizeof(sample_ring_header_t)) {
+        return false;
+    }
+
+    sample_ring_header_t * header = (sample_ring_header_t *)memory;
+    if(header->magic != SAMPLE_RING_MAGIC || header->version != SAMPLE_RING_VERSION) {
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if(!is_power_of_two(header->capacity) || header->record_size == 0 ||
+       size < sample_ring_memory_size(header->capacity, header->record_size)) {
+        return false;
+    }
+
+    Ring->header = header;
+    Ring->records = (uint8_t *)memory + sizeof(sample_ring_header_t);
+    Ring->mask = header->capacity - 1;
+    Ring->record_size = header->record_size;
+    return true;
+}
+
+/*
+    @brief gets contiguous free space to write records into
+    @note producer only, records become visible to the consumer with sample_ring_commit()
+    @param Ring Pointer to ring handler
+    @param count set to the number of records that fit, may be less than the free space at the end of the ring
+    @retval start of the free space
+*/
+void * sample_ring_reserve(sample_ring_t * Ring, uint32_t * count) {
+    uint32_t head = atomic_load_explicit(&Ring->header->head, memory_order_relaxed); // only we write head
+    uint32_t tail = atomic_load_explicit(&Ring->header->tail, memory_order_acquire);
+    uint32_t free_space = (Ring->mask + 1) - (head - tail);
+    uint32_t to_end = (Ring->mask + 1) - (head & Ring->mask);
+
+    *count = free_space < to_end ? free_space : to_end;
+    return Ring->records + (size_t)(head & Ring->mask) * Ring->record_size;
+}
+
+/*
+    @brief publishes records written after sample_ring_reserve()
+    @note producer only, wakes the consumer if it is sleeping
+    @param Ring Pointer to ring handler
+    @param count number of records written, at most the reserved count
+    @retval None
+*/
+void sample_ring_commit(sample_ring_t * Ring, uint32_t count) {
+    if(count == 0) {
+        return;
+    }
+    uint32_t head = atomic_load_explicit(&Ring->header->head, memory_order_relaxed);
+    atomic_store_explicit(&Ring->header->head, head + count, memory_order_release);
+
+    // seq_cst pairs with the consumer setting consumer_waiting then checking head,
+    // one of the two always sees the other so a wake-up is never lost
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&Ring->header->consumer_waiting, memory_order_relaxed)) {
+        atomic_store_explicit(&Ring->header->consumer_waiting, 0, memory_order_relaxed);
+#ifdef __linux__
+        futex_wake(&Ring->header->head);
+#endif
+    }
+}
+
+/*
+    @brief copies records into the ring and publishes them
+    @note producer only
+    @param Ring Pointer to ring handler
+    @param records records to write
+    @param count number of records
+    @retval number of records written, less than count if the ring is full
+*/
+uint32_t sample_ring_write(sample_ring_t * Ring, const void * records, uint32_t count) {
+    const uint8_t * input = (const uint8_t *)records;
+    uint32_t written = 0;
+
+    // at most two parts, up to the end of the ring and from its start
+    for(uint8_t part = 0; part < 2 && written < count; part++) {
+        uint32_t space;
+        uint8_t * output = (uint8_t *)sample_ring_reserve(Ring, &space);
+        uint32_t n = count - written < space ? count - written : space;
+        if(n == 0) {
+            break;
+        }
+        memcpy(output, input + (size_t)written * Ring->record_size, (size_t)n * Ring->record_size);
+        written += n;
+        // publish the first part before reserving the second, reserve reads head
+        sample_ring_commit(Ring, n);
+    }
+
+    return written;
+}
+
+/*
+    @brief gets contiguous records that are ready to read, without copying them
+    @note consumer only, the records stay valid until sample_ring_release()
+    @param Ring Pointer to ring handler
+    @param count set to the number of contiguous records ready to read
+    @retval first record
+*/
+const void * sample_ring_peek(sample_ring_t * Ring, uint32_t * count) {
+    uint32_t tail = atomic_load_explicit(&Ring->header->tail, memory_order_relaxed); // only we write tail
+    uint32_t head = atomic_load_explicit(&Ring->header->head, memory_order_acquire);
+    uint32_t ready = head - tail;
+    uint32_t to_end = (Ring->mask + 1) - (tail & Ring->mask);
+
+    *count = ready < to_end ? ready : to_end;
+    return Ring->records + (size_t)(tail & Ring->mask) * Ring->record_size;
+}
+
+/*
+    @brief frees records returned by sample_ring_peek()
+    @note consumer only, wakes the producer if it is sleeping
+    @param Ring Pointer to ring handler
+    @param count number of records read, at most the peeked count
+    @retval None
+*/
+void sample_ring_release(sample_ring_t * Ring, uint32_t count) {
+    if(count == 0) {
+        return;
+    }
+    uint32_t tail = atomic_load_explicit(&Ring->header->tail, memory_order_relaxed);
+    atomic_store_explicit(&Ring->header->tail, tail + count, memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&Ring->header->producer_waiting, memory_order_relaxed)) {
+        atomic_store_explicit(&Ring->header->producer_waiting, 0, memory_order_relaxed);
+#ifdef __linux__
+        futex_wake(&Ring->header->tail);
+#endif
+    }
+}
+
+/*
+    @brief sleeps until records are ready to read
+    @note consumer only, uses a futex on Linux, returns right away on other platforms
+    @param Ring Pointer to ring handler
+    @param timeout_ms longest time (ms) to sleep, negative to wait forever
+    @retval true if records are ready to read
+*/
+bool sample_ring_wait_readable(sample_ring_t * Ring, int32_t timeout_ms) {
+    uint32_t tail = atomic_load_explicit(&Ring->header->tail, memory_order_relaxed);
+    if(atomic_load_explicit(&Ring->header->head, memory_order_acquire) != tail) {
+        return true;
+    }
+
+#ifdef __linux__
+    atomic_store_explicit(&Ring->header->consumer_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    // head is still tail if the ring is empty, the futex returns at once if it changed since
+    futex_wait(&Ring->header->head, tail, timeout_ms);
+    atomic_store_explicit(&Ring->header->consumer_waiting, 0, memory_order_relaxed);
+#else
+    (void)timeout_ms;
+#endif
+
+    return atomic_load_explicit(&Ring->header->head, memory_order_acquire) != tail;
+}
+
+/*
+    @brief sleeps until there is space to write
+    @note producer only, uses a futex on Linux, returns right away on other platforms
+    @param Ring Pointer to ring handler
+    @param timeout_ms longest time (ms) to sleep, negative to wait forever
+    @retval true if there is space to write
+*/
+bool sample_ring_wait_writable(sample_ring_t * Ring, int32_t timeout_ms) {
+    uint32_t head = atomic_load_explicit(&Ring->header->head, memory_order_relaxed);
+    uint32_t full_tail = head - (Ring->mask + 1); // tail while the ring is full
+    if(atomic_load_explicit(&Ring->header->tail, memory_order_acquire) != full_tail) {
+        return true;
+    }
+
+#ifdef __linux__
+    atomic_store_explicit(&Ring->header->producer_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    futex_wait(&Ring->header->tail, full_tail, timeout_ms);
+    atomic_store_explicit(&Ring->header->producer_waiting, 0, memory_order_relaxed);
+#else
+    (void)timeout_ms;
+#endif
+
+    return atomic_load_explicit(&Ring->header->tail, memory_order_acquire) != full_tail;
+}
+
+/*
+    @brief writes the latest beat of the pulse sensor as a pulse_beat_event_t
+    @note producer only, call when take_start_of_beat() returns true, record_size must be sizeof(pulse_beat_event_t)
+    @param Ring Pointer to ring handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval true if the event was written, false if the ring is full
+*/
+bool sample_ring_write_beat(sample_ring_t * Ring, pulse_sensor_t * PS) {
+    if(Ring->record_size != sizeof(pulse_beat_event_t)) {
+        return false;
+    }
+
+    pulse_beat_event_t event;
+    memset(&event, 0, sizeof(event)); // no stale padding bytes in shared memory
+    event.time = PS->last_beat_time;
+    event.IBI = PS->IBI;
+    event.amplitude = PS->amplitude;
+    event.BPM = PS->BPM;
+    event.quality = PS->quality;
+    return sample_ring_write(Ring, &event, 1) == 1;
+}
+
+#ifdef __linux__
+/*
+    @brief creates anonymous shared memory for a ring
+    @note pass the fd to the other process (fork, or SCM_RIGHTS over a unix socket) and map it there too
+    @param name name shown in /proc/<pid>/fd, for debugging
+    @param size bytes, see sample_ring_memory_size()
+    @retval file descriptor, -1 on error
+*/
+int sample_ring_create_shared(const char * name, size_t size) {
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+    if(ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+    @brief maps shared memory created by sample_ring_create_shared()
+    @param fd file descriptor
+    @param size bytes
+    @retval mapping, NULL on error
+*/
+void * sample_ring_map_shared(int fd, size_t size) {
+    void * memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+#endif
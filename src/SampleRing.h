@@ -0,0 +1,212 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Sample Ring
+
+  @File Name
+    SampleRing.h
+
+  @Summary
+    Lock-free shared memory ring for passing samples and beat events between processes
+
+  @Description
+    Defines a single producer, single consumer ring of fixed size records that
+    lives entirely in a caller provided memory block, e.g. a memfd mapping shared
+    by an acquisition and an analysis process. The consumer reads records in place
+    (peek/release) and waits on a futex that the producer only wakes when the
+    consumer is actually sleeping. Requires C11 atomics.
+******************************************************************************/
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include "HeartRate.h"
+#include <stddef.h>
+
+// the header is shared with C++ processes, std::atomic<uint32_t> has the layout of _Atomic uint32_t (checked below)
+#ifdef __cplusplus
+#include <atomic>
+#define SAMPLE_RING_ATOMIC_U32 std::atomic<uint32_t>
+#else
+#include <stdatomic.h>
+#define SAMPLE_RING_ATOMIC_U32 _Atomic uint32_t
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_RING_MAGIC 0x50525247 // "GRRP" little endian
+#define SAMPLE_RING_VERSION 1
+#define SAMPLE_RING_CACHE_LINE 64 // producer and consumer indexes are kept on separate cache lines
+
+typedef struct {
+    float signal; // sample value
+    uint32_t ms; // time (ms) since the previous sample, as passed to pulse_sensor_process_sample()
+}pulse_sample_t;
+
+typedef struct {
+    uint64_t time; // last_beat_time of the beat (ms)
+    uint32_t IBI; // inter beat interval (ms)
+    float amplitude; // amplitude of the previous pulse
+    uint8_t BPM; // beats per minute after the beat
+    uint8_t quality; // signal quality index after the beat
+}pulse_beat_event_t;
+
+typedef struct {
+    // written once by sample_ring_init()
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity; // records in the ring, power of 2
+    uint32_t record_size; // bytes per record
+    uint8_t pad0[SAMPLE_RING_CACHE_LINE - 4 * sizeof(uint32_t)];
+
+    // written by the producer
+    SAMPLE_RING_ATOMIC_U32 head; // records written since init, also the futex word the consumer waits on
+    SAMPLE_RING_ATOMIC_U32 consumer_waiting; // set by a sleeping consumer, producer wakes it when set
+    uint8_t pad1[SAMPLE_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+
+    // written by the consumer
+    SAMPLE_RING_ATOMIC_U32 tail; // records released since init, also the futex word the producer waits on
+    SAMPLE_RING_ATOMIC_U32 producer_waiting; // set by a sleeping producer, consumer wakes it when set
+    uint8_t pad2[SAMPLE_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+}sample_ring_header_t;
+
+#ifdef __cplusplus
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+              "the ring header needs lock-free 32 bit atomics with the layout of uint32_t");
+static_assert(offsetof(sample_ring_header_t, head) == SAMPLE_RING_CACHE_LINE && offsetof(sample_ring_header_t, tail) == 2 * SAMPLE_RING_CACHE_LINE,
+              "the ring header must have the same layout as in C");
+#endif
+
+typedef struct {
+    sample_ring_header_t * header; // start of the shared memory block
+    uint8_t * records; // record storage, follows the header
+    uint32_t mask; // capacity - 1
+    uint32_t record_size;
+}sample_ring_t;
+
+/*
+    @brief shared memory needed for a ring
+    @param capacity number of records, power of 2
+    @param record_size bytes per record, e.g. sizeof(pulse_sample_t)
+    @retval bytes
+*/
+size_t sample_ring_memory_size(uint32_t capacity, uint32_t record_size);
+
+/*
+    @brief formats a memory block as an empty ring and attaches to it
+    @note call once, from the side that creates the shared memory
+    @param Ring Pointer to ring handler
+    @param memory memory block, aligned to SAMPLE_RING_CACHE_LINE (mmap memory is)
+    @param size size of memory (bytes)
+    @param capacity number of records, power of 2
+    @param record_size bytes per record
+    @retval true if the ring fits in memory
+*/
+bool sample_ring_init(sample_ring_t * Ring, void * memory, size_t size, uint32_t capacity, uint32_t record_size);
+
+/*
+    @brief attaches to a ring formatted by sample_ring_init(), e.g. in the other process
+    @param Ring Pointer to ring handler
+    @param memory memory block holding the ring
+    @param size size of memory (bytes)
+    @retval true if memory holds a valid ring
+*/
+bool sample_ring_attach(sample_ring_t * Ring, void * memory, size_t size);
+
+/*
+    @brief gets contiguous free space to write records into
+    @note producer only, records become visible to the consumer with sample_ring_commit()
+    @param Ring Pointer to ring handler
+    @param count set to the number of records that fit, may be less than the free space at the end of the ring
+    @retval start of the free space
+*/
+void * sample_ring_reserve(sample_ring_t * Ring, uint32_t * count);
+
+/*
+    @brief publishes records written after sample_ring_reserve()
+    @note producer only, wakes the consumer if it is sleeping
+    @param Ring Pointer to ring handler
+    @param count number of records written, at most the reserved count
+    @retval None
+*/
+void sample_ring_commit(sample_ring_t * Ring, uint32_t count);
+
+/*
+    @brief copies records into the ring and publishes them
+    @note producer only
+    @param Ring Pointer to ring handler
+    @param records records to write
+    @param count number of records
+    @retval number of records written, less than count if the ring is full
+*/
+uint32_t sample_ring_write(sample_ring_t * Ring, const void * records, uint32_t count);
+
+/*
+    @brief gets contiguous records that are ready to read, without copying them
+    @note consumer only, the records stay valid until sample_ring_release()
+    @param Ring Pointer to ring handler
+    @param count set to the number of contiguous records ready to read
+    @retval first record
+*/
+const void * sample_ring_peek(sample_ring_t * Ring, uint32_t * count);
+
+/*
+    @brief frees records returned by sample_ring_peek()
+    @note consumer only, wakes the producer if it is sleeping
+    @param Ring Pointer to ring handler
+    @param count number of records read, at most the peeked count
+    @retval None
+*/
+void sample_ring_release(sample_ring_t * Ring, uint32_t count);
+
+/*
+    @brief sleeps until records are ready to read
+    @note consumer only, uses a futex on Linux, returns right away on other platforms
+    @param Ring Pointer to ring handler
+    @param timeout_ms longest time (ms) to sleep, negative to wait forever
+    @retval true if records are ready to read
+*/
+bool sample_ring_wait_readable(sample_ring_t * Ring, int32_t timeout_ms);
+
+/*
+    @brief sleeps until there is space to write
+    @note producer only, uses a futex on Linux, returns right away on other platforms
+    @param Ring Pointer to ring handler
+    @param timeout_ms longest time (ms) to sleep, negative to wait forever
+    @retval true if there is space to write
+*/
+bool sample_ring_wait_writable(sample_ring_t * Ring, int32_t timeout_ms);
+
+/*
+    @brief writes the latest beat of the pulse sensor as a pulse_beat_event_t
+    @note producer only, call when take_start_of_beat() returns true, record_size must be sizeof(pulse_beat_event_t)
+    @param Ring Pointer to ring handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval true if the event was written, false if the ring is full
+*/
+bool sample_ring_write_beat(sample_ring_t * Ring, pulse_sensor_t * Pulse_Sensor);
+
+#ifdef __linux__
+/*
+    @brief creates anonymous shared memory for a ring
+    @note pass the fd to the other process (fork, or SCM_RIGHTS over a unix socket) and map it there too
+    @param name name shown in /proc/<pid>/fd, for debugging
+    @param size bytes, see sample_ring_memory_size()
+    @retval file descriptor, -1 on error
+*/
+int sample_ring_create_shared(const char * name, size_t size);
+
+/*
+    @brief maps shared memory created by sample_ring_create_shared()
+    @param fd file descriptor
+    @param size bytes
+    @retval mapping, NULL on error
+*/
+void * sample_ring_map_shared(int fd, size_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_RING_H
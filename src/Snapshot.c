@@ -0,0 +1,246 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Snapshot
+
+  @File Name
+    Snapshot.c
+
+  @Summary
+    Saves and restores the full pulse sensor state
+
+  @Description
+    Implements functions that serialize pulse_sensor_t into a versioned,
+    checksummed byte buffer (e.g. retained RAM, flash or a file) and bring it
+    back, including a warm start that reports a stable BPM right away
+******************************************************************************/
+
+#include "Snapshot.h"
+#include <string.h>
+
+#define RATE_LENGTH (sizeof(((pulse_sensor_t *)0)->rate) / sizeof(uint32_t))
+
+// sizes for each version, 143 and 152 with the default window of 10
+static const size_t snapshot_size[PULSE_SNAPSHOT_VERSION + 1] = {
+    0,
+    103 + RATE_LENGTH * sizeof(uint32_t), // 1: pulse detection and signal quality
+    PULSE_SNAPSHOT_FIXED_SIZE + RATE_LENGTH * sizeof(uint32_t) // 2: beat time interpolation
+};
+
+typedef struct {
+    uint8_t * data; // NULL while reading
+    const uint8_t * input;
+    size_t pos;
+}cursor_t;
+
+// all values are stored little endian so snapshots move between micro and host
+static void put(cursor_t * c, uint64_t value, uint8_t bytes) {
+    for(uint8_t i = 0; i < bytes; i++) {
+        c->data[c->pos++] = (uint8_t)(value >> (8*i));
+    }
+}
+
+static void put_float(cursor_t * c, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put(c, bits, 4);
+}
+
+static uint64_t get(cursor_t * c, uint8_t bytes) {
+    uint64_t value = 0;
+    for(uint8_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)c->input[c->pos++] << (8*i);
+    }
+    return value;
+}
+
+static float get_float(cursor_t * c) {
+    uint32_t bits = (uint32_t)get(c, 4);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// CRC-16/CCITT-FALSE, small enough to not need a table on the micro
+static uint16_t crc16(const uint8_t * data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/*
+    @brief serializes the pulse sensor state
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer destination, at least PULSE_SNAPSHOT_SIZE bytes
+    @param length size of buffer (bytes)
+    @retval bytes written, 0 if buffer is too small
+*/
+size_t pulse_sensor_snapshot(const pulse_sensor_t * PS, uint8_t * buffer, size_t length) {
+    if(length < PULSE_SNAPSHOT_SIZE) {
+        return 0;
+    }
+
+    cursor_t c = {buffer, NULL, 0};
+
+    put(&c, PULSE_SNAPSHOT_MAGIC, 4);
+    put(&c, PULSE_SNAPSHOT_VERSION, 1);
+    put(&c, RATE_LENGTH, 1);
+
+    // pulse detection variables
+    put_float(&c, PS->signal);
+    put(&c, PS->BPM, 1);
+    put(&c, PS->IBI, 4);
+    put(&c, PS->pulse, 1);
+    put(&c, PS->start_of_beat, 1);
+    put_float(&c, PS->thresh_setting);
+    put_float(&c, PS->amplitude);
+    put(&c, PS->last_beat_time, 8);
+    for(uint8_t i = 0; i < RATE_LENGTH; i++) {
+        put(&c, PS->rate[i], 4);
+    }
+    put(&c, PS->sample_counter, 8);
+    put(&c, PS->N, 8);
+    put_float(&c, PS->peak);
+    put_float(&c, PS->trough);
+    put_float(&c, PS->thresh);
+    put(&c, PS->first_beat, 1);
+    put(&c, PS->second_beat, 1);
+    put(&c, PS->warm_start, 1);
+
+    // signal quality variables
+    put(&c, PS->quality, 1);
+    put(&c, PS->reset_count, 4);
+    put_float(&c, PS->amplitude_mean);
+    put_float(&c, PS->amplitude_deviation);
+    put_float(&c, PS->IBI_mean);
+    put_float(&c, PS->IBI_deviation);
+    put_float(&c, PS->reset_rate);
+    put_float(&c, PS->clip_rate);
+    put(&c, PS->beat_samples, 4);
+    put(&c, PS->clipped_samples, 4);
+
+    // beat time interpolation variables
+    put(&c, PS->interpolate, 1);
+    put_float(&c, PS->prev_signal);
+    put_float(&c, PS->beat_offset);
+
+    put(&c, crc16(buffer, c.pos), 2);
+    return c.pos;
+}
+
+/*
+    @brief restores the pulse sensor state exactly as it was saved
+    @note the pulse sensor is left untouched if the snapshot is not valid, beat_count is
+          not saved and keeps its current value so stages watching it do not see a beat
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer snapshot written by pulse_sensor_snapshot()
+    @param length size of buffer (bytes)
+    @retval true if the snapshot was valid and restored
+*/
+bool pulse_sensor_restore(pulse_sensor_t * PS, const uint8_t * buffer, size_t length) {
+    if(length < 6) {
+        return false;
+    }
+
+    cursor_t c = {NULL, buffer, 0};
+
+    if(get(&c, 4) != PULSE_SNAPSHOT_MAGIC) {
+        return false;
+    }
+
+    uint8_t version = (uint8_t)get(&c, 1);
+    if(version == 0 || version > PULSE_SNAPSHOT_VERSION || length < snapshot_size[version] || get(&c, 1) != RATE_LENGTH) {
+        return false;
+    }
+
+    size_t size = snapshot_size[version];
+    cursor_t crc = {NULL, buffer, size - 2};
+    if(get(&crc, 2) != crc16(buffer, size - 2)) {
+        return false;
+    }
+
+    pulse_sensor_t restored;
+
+    // pulse detection variables
+    restored.signal = get_float(&c);
+    restored.BPM = (uint8_t)get(&c, 1);
+    restored.IBI = (uint32_t)get(&c, 4);
+    restored.pulse = get(&c, 1);
+    restored.start_of_beat = get(&c, 1);
+    restored.thresh_setting = get_float(&c);
+    restored.amplitude = get_float(&c);
+    restored.last_beat_time = get(&c, 8);
+    for(uint8_t i = 0; i < RATE_LENGTH; i++) {
+        restored.rate[i] = (uint32_t)get(&c, 4);
+    }
+    restored.sample_counter = get(&c, 8);
+    restored.N = get(&c, 8);
+    restored.peak = get_float(&c);
+    restored.trough = get_float(&c);
+    restored.thresh = get_float(&c);
+    restored.first_beat = get(&c, 1);
+    restored.second_beat = get(&c, 1);
+    restored.warm_start = get(&c, 1);
+
+    // signal quality variables
+    restored.quality = (uint8_t)get(&c, 1);
+    restored.reset_count = (uint32_t)get(&c, 4);
+    restored.amplitude_mean = get_float(&c);
+    restored.amplitude_deviation = get_float(&c);
+    restored.IBI_mean = get_float(&c);
+    restored.IBI_deviation = get_float(&c);
+    restored.reset_rate = get_float(&c);
+    restored.clip_rate = get_float(&c);
+    restored.beat_samples = (uint32_t)get(&c, 4);
+    restored.clipped_samples = (uint32_t)get(&c, 4);
+
+    // beat time interpolation variables, off in older snapshots
+    restored.interpolate = false;
+    restored.prev_signal = restored.signal;
+    restored.beat_offset = 0;
+    if(version >= 2) {
+        restored.interpolate = get(&c, 1);
+        restored.prev_signal = get_float(&c);
+        restored.beat_offset = get_float(&c);
+    }
+
+    restored.beat_count = PS->beat_count; // a restore is not a beat, keep counting from the live value
+    *PS = restored;
+    return true;
+}
+
+/*
+    @brief restores the pulse sensor state after an unknown amount of time has passed
+    @note keeps BPM, the rate array, thresh and signal statistics so a stable BPM is reported
+          right away, the first beat after resuming is only used to find the beat phase again
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer snapshot written by pulse_sensor_snapshot()
+    @param length size of buffer (bytes)
+    @retval true if the snapshot was valid and restored
+*/
+bool pulse_sensor_resume(pulse_sensor_t * PS, const uint8_t * buffer, size_t length) {
+    if(!pulse_sensor_restore(PS, buffer, length)) {
+        return false;
+    }
+
+    // the time since the last beat is unknown, so start timing from now
+    PS->last_beat_time = PS->sample_counter;
+    PS->N = 0;
+    PS->pulse = false;
+    PS->start_of_beat = false;
+    PS->peak = PS->thresh; // look for a new peak and trough around the learned thresh
+    PS->trough = PS->thresh;
+    PS->beat_samples = 0;
+    PS->clipped_samples = 0;
+    PS->prev_signal = PS->thresh; // no interpolation across the gap
+    PS->beat_offset = 0;
+
+    // discard the first IBI (it starts at an unknown time) but keep the rate array
+    PS->first_beat = true;
+    PS->second_beat = false;
+    PS->warm_start = PS->BPM > 0;
+    return true;
+}
@@ -0,0 +1,70 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Snapshot
+
+  @File Name
+    Snapshot.h
+
+  @Summary
+    Saves and restores the full pulse sensor state
+
+  @Description
+    Defines functions that serialize pulse_sensor_t into a versioned,
+    checksummed byte buffer (e.g. retained RAM, flash or a file) and bring it
+    back, including a warm start that reports a stable BPM right away
+******************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "HeartRate.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PULSE_SNAPSHOT_MAGIC 0x50534E50 // "PNSP" little endian
+#define PULSE_SNAPSHOT_VERSION 2 // version 1 snapshots can still be restored
+#define PULSE_SNAPSHOT_FIXED_SIZE 112 // bytes of a PULSE_SNAPSHOT_VERSION snapshot besides the rate array
+#define PULSE_SNAPSHOT_SIZE (PULSE_SNAPSHOT_FIXED_SIZE + PULSE_RATE_WINDOW * 4) // bytes written by pulse_sensor_snapshot(), 152 with the default window
+
+#if PULSE_RATE_WINDOW > 255
+#error "PULSE_RATE_WINDOW is stored in one byte of a snapshot, keep it at most 255"
+#endif
+
+/*
+    @brief serializes the pulse sensor state
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer destination, at least PULSE_SNAPSHOT_SIZE bytes
+    @param length size of buffer (bytes)
+    @retval bytes written, 0 if buffer is too small
+*/
+size_t pulse_sensor_snapshot(const pulse_sensor_t * Pulse_Sensor, uint8_t * buffer, size_t length);
+
+/*
+    @brief restores the pulse sensor state exactly as it was saved
+    @note the pulse sensor is left untouched if the snapshot is not valid, beat_count is
+          not saved and keeps its current value so stages watching it do not see a beat
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer snapshot written by pulse_sensor_snapshot()
+    @param length size of buffer (bytes)
+    @retval true if the snapshot was valid and restored
+*/
+bool pulse_sensor_restore(pulse_sensor_t * Pulse_Sensor, const uint8_t * buffer, size_t length);
+
+/*
+    @brief restores the pulse sensor state after an unknown amount of time has passed
+    @note keeps BPM, the rate array, thresh and signal statistics so a stable BPM is reported
+          right away, the first beat after resuming is only used to find the beat phase again
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param buffer snapshot written by pulse_sensor_snapshot()
+    @param length size of buffer (bytes)
+    @retval true if the snapshot was valid and restored
+*/
+bool pulse_sensor_resume(pulse_sensor_t * Pulse_Sensor, const uint8_t * buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,150 @@
+/* ****************************************************************************/
+/** Spectral Heart Rate Estimator
+
+  @File Name
+    Spectral.c
+
+  @Summary
+    Calculates BPM from a sliding DFT of the analog signal
+
+  @Description
+    Implements functions for a second BPM source that works on low perfusion
+    signals where the threshold crossing detector fails, a sliding DFT over
+    the 40-220 BPM band is updated in O(bins) per sample
+******************************************************************************/
+
+#include "Spectral.h"
+#include <math.h>
+#include <string.h>
+
+#define SPECTRAL_DAMPING 0.9999f // keeps rounding errors in the recursion from building up
+#define SPECTRAL_BASELINE_SHIFT 32 // baseline follows 1/32 of each decimated sample (~1.3 s)
+#define SPECTRAL_LOBE_BINS 3 // bins either side of the peak inside the main lobe (25 Hz / 256 = 5.9 BPM)
+#define SPECTRAL_PI 3.14159265f
+
+static void estimate(spectral_bpm_t * SP) {
+    float power[SPECTRAL_BINS];
+    float total = 0;
+    uint8_t best = 0;
+
+    for(uint8_t k = 0; k < SPECTRAL_BINS; k++) {
+        power[k] = SP->re[k]*SP->re[k] + SP->im[k]*SP->im[k];
+        total += power[k];
+        if(power[k] > power[best]) {
+            best = k;
+        }
+    }
+
+    if(total <= 0) {
+        SP->BPM = 0;
+        SP->confidence = 0;
+        return;
+    }
+
+    // parabolic interpolation between neighbouring bins
+    float offset = 0;
+    if(best > 0 && best < SPECTRAL_BINS - 1) {
+        float a = sqrtf(power[best-1]), b = sqrtf(power[best]), c = sqrtf(power[best+1]);
+        float denom = a - 2*b + c;
+        if(denom != 0) {
+            offset = 0.5f * (a - c) / denom;
+        }
+    }
+    SP->BPM = (uint8_t)(SPECTRAL_MIN_BPM + (best + offset) * SPECTRAL_BPM_STEP + 0.5f);
+
+    float lobe = 0;
+    for(int k = best - SPECTRAL_LOBE_BINS; k <= best + SPECTRAL_LOBE_BINS; k++) {
+        if(k >= 0 && k < SPECTRAL_BINS) {
+            lobe += power[k];
+        }
+    }
+    SP->confidence = lobe / total;
+}
+
+static void push_sample(spectral_bpm_t * SP, float x) {
+    float leaving = SP->filled == SPECTRAL_WINDOW ? SP->window[SP->head] : 0;
+
+    SP->window[SP->head] = x;
+    SP->head = (SP->head + 1) % SPECTRAL_WINDOW;
+    if(SP->filled < SPECTRAL_WINDOW) {
+        SP->filled++;
+    }
+
+    // X(n) = x(n) + r*e^(jw)*X(n-1) - r^N*e^(jwN)*x(n-N)
+    for(uint8_t k = 0; k < SPECTRAL_BINS; k++) {
+        float re = SP->rotate_re[k]*SP->re[k] - SP->rotate_im[k]*SP->im[k];
+        float im = SP->rotate_re[k]*SP->im[k] + SP->rotate_im[k]*SP->re[k];
+        SP->re[k] = re + x - SP->leave_re[k]*leaving;
+        SP->im[k] = im - SP->leave_im[k]*leaving;
+    }
+
+    if(SP->filled == SPECTRAL_WINDOW) {
+        estimate(SP);
+    }
+}
+
+/*
+    @brief spectral estimator initialization
+    @param Spectral Pointer to spectral estimator handler
+    @retval None
+*/
+void spectral_bpm_init(spectral_bpm_t * SP) {
+    memset(SP, 0, sizeof(*SP));
+
+    float damping_n = powf(SPECTRAL_DAMPING, SPECTRAL_WINDOW);
+    for(uint8_t k = 0; k < SPECTRAL_BINS; k++) {
+        float hz = (SPECTRAL_MIN_BPM + k * SPECTRAL_BPM_STEP) / 60.0f;
+        float w = 2 * SPECTRAL_PI * hz * SPECTRAL_PERIOD_MS / 1000.0f; // radians per decimated sample
+        SP->rotate_re[k] = SPECTRAL_DAMPING * cosf(w);
+        SP->rotate_im[k] = SPECTRAL_DAMPING * sinf(w);
+        SP->leave_re[k] = damping_n * cosf(w * SPECTRAL_WINDOW);
+        SP->leave_im[k] = damping_n * sinf(w * SPECTRAL_WINDOW);
+    }
+}
+
+/*
+    @brief processes the latest sample value
+    @note call alongside pulse_sensor_process_sample(), reads signal from the pulse sensor
+    @param Spectral Pointer to spectral estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void spectral_bpm_process_sample(spectral_bpm_t * SP, pulse_sensor_t * PS, uint32_t ms) {
+    SP->accumulator += PS->signal;
+    SP->accumulated++;
+    SP->accumulated_ms += ms;
+
+    if(SP->accumulated_ms < SPECTRAL_PERIOD_MS) {
+        return;
+    }
+
+    float x = SP->accumulator / SP->accumulated;
+    SP->accumulator = 0;
+    SP->accumulated = 0;
+    SP->accumulated_ms -= SPECTRAL_PERIOD_MS;
+
+    if(SP->filled == 0) {
+        SP->baseline = x; // seed with the first decimated sample
+    }
+    SP->baseline += (x - SP->baseline) / SPECTRAL_BASELINE_SHIFT; // remove DC and slow wander
+    push_sample(SP, x - SP->baseline);
+}
+
+/*
+    @brief get the spectral bpm measurement
+    @param Spectral Pointer to spectral estimator handler
+    @retval BPM value
+*/
+uint8_t get_spectral_beats_per_minute(spectral_bpm_t * SP) {
+    return SP->BPM;
+}
+
+/*
+    @brief get confidence of the spectral bpm measurement
+    @param Spectral Pointer to spectral estimator handler
+    @retval confidence, 0-1
+*/
+float get_spectral_confidence(spectral_bpm_t * SP) {
+    return SP->confidence;
+}
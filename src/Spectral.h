@@ -0,0 +1,88 @@
+/* ****************************************************************************/
+/** Spectral Heart Rate Estimator
+
+  @File Name
+    Spectral.h
+
+  @Summary
+    Calculates BPM from a sliding DFT of the analog signal
+
+  @Description
+    Defines functions for a second BPM source that works on low perfusion
+    signals where the threshold crossing detector fails, a sliding DFT over
+    the 40-220 BPM band is updated in O(bins) per sample
+******************************************************************************/
+
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPECTRAL_PERIOD_MS 40 // samples are averaged down to this period (25 Hz) before the DFT
+#define SPECTRAL_WINDOW 256 // DFT window in decimated samples (~10 seconds)
+#define SPECTRAL_MIN_BPM 40
+#define SPECTRAL_MAX_BPM 220
+#define SPECTRAL_BPM_STEP 2 // bin spacing (BPM)
+#define SPECTRAL_BINS ((SPECTRAL_MAX_BPM - SPECTRAL_MIN_BPM) / SPECTRAL_BPM_STEP + 1)
+
+typedef struct {
+    // spectral output variables
+    uint8_t BPM; // beats per minute of the strongest bin, 0 until the window is full
+    float confidence; // share of in-band power around the strongest bin, 0-1
+
+    // spectral internal variables
+    float window[SPECTRAL_WINDOW]; // ring buffer of decimated samples
+    uint16_t head; // next index to write in window
+    uint16_t filled; // decimated samples in window
+    float baseline; // slow average removed from the signal
+    float accumulator; // sum of samples being decimated
+    uint16_t accumulated; // number of samples in accumulator
+    uint32_t accumulated_ms; // time (ms) covered by accumulator
+    float re[SPECTRAL_BINS]; // sliding DFT of each bin
+    float im[SPECTRAL_BINS];
+    float rotate_re[SPECTRAL_BINS]; // r * e^(jw), applied every sample
+    float rotate_im[SPECTRAL_BINS];
+    float leave_re[SPECTRAL_BINS]; // r^N * e^(jwN), applied to the sample leaving the window
+    float leave_im[SPECTRAL_BINS];
+}spectral_bpm_t;
+
+/*
+    @brief spectral estimator initialization
+    @param Spectral Pointer to spectral estimator handler
+    @retval None
+*/
+void spectral_bpm_init(spectral_bpm_t * Spectral);
+
+/*
+    @brief processes the latest sample value
+    @note call alongside pulse_sensor_process_sample(), reads signal from the pulse sensor
+    @param Spectral Pointer to spectral estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval None
+*/
+void spectral_bpm_process_sample(spectral_bpm_t * Spectral, pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+/*
+    @brief get the spectral bpm measurement
+    @param Spectral Pointer to spectral estimator handler
+    @retval BPM value
+*/
+uint8_t get_spectral_beats_per_minute(spectral_bpm_t * Spectral);
+
+/*
+    @brief get confidence of the spectral bpm measurement
+    @param Spectral Pointer to spectral estimator handler
+    @retval confidence, 0-1
+*/
+float get_spectral_confidence(spectral_bpm_t * Spectral);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPECTRAL_H
@@ -0,0 +1,191 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Startup Estimator
+
+  @File Name
+    Startup.c
+
+  @Summary
+    Seeds the pulse sensor from a look-back estimate over the first seconds
+
+  @Description
+    Implements functions that buffer the first few seconds of signal (and the
+    first seconds after every reset), run a one-shot autocorrelation over the
+    buffer and seed rate, thresh and IBI so BPM is reported sooner
+******************************************************************************/
+
+#include "Startup.h"
+#include <math.h>
+
+#define MIN_LAG (60000 / (STARTUP_MAX_BPM * STARTUP_PERIOD_MS))
+#define MAX_LAG (60000 / (STARTUP_MIN_BPM * STARTUP_PERIOD_MS))
+#define LAGS (MAX_LAG - MIN_LAG + 1)
+#define HARMONIC_RATIO 0.7f // shortest lag within this ratio of the best wins, avoids locking onto 1/2 BPM
+
+static void restart(startup_t * ST, pulse_sensor_t * PS) {
+    ST->done = false;
+    ST->seeded = false;
+    ST->correlation = 0;
+    ST->count = 0;
+    ST->accumulator = 0;
+    ST->accumulated = 0;
+    ST->accumulated_ms = 0;
+    ST->reset_count = PS->reset_count;
+}
+
+// normalized correlation of the buffer with itself shifted by lag
+static float correlation(const float * x, uint16_t count, float mean, uint16_t lag) {
+    float xy = 0, xx = 0, yy = 0;
+    for(uint16_t i = 0; i + lag < count; i++) {
+        float a = x[i] - mean, b = x[i + lag] - mean;
+        xy += a * b;
+        xx += a * a;
+        yy += b * b;
+    }
+    return (xx > 0 && yy > 0) ? xy / sqrtf(xx * yy) : 0;
+}
+
+// one-shot estimate of the beat period, returns the period in buffered samples or 0
+static float estimate_period(startup_t * ST) {
+    float r[LAGS];
+    float mean = 0;
+
+    for(uint16_t i = 0; i < ST->count; i++) {
+        mean += ST->samples[i];
+    }
+    mean /= ST->count;
+
+    uint8_t best = 0;
+    for(uint8_t i = 0; i < LAGS; i++) {
+        r[i] = correlation(ST->samples, ST->count, mean, MIN_LAG + i);
+        if(r[i] > r[best]) {
+            best = i;
+        }
+    }
+
+    // prefer the first local maximum that is close to the best, multiples of the period correlate too
+    for(uint8_t i = 1; i + 1 < best; i++) {
+        if(r[i] >= r[i-1] && r[i] >= r[i+1] && r[i] >= HARMONIC_RATIO * r[best]) {
+            best = i;
+            break;
+        }
+    }
+
+    ST->correlation = r[best] < 0 ? 0 : r[best];
+    if(ST->correlation < STARTUP_MIN_CORRELATION) {
+        return 0;
+    }
+
+    // parabolic interpolation between neighbouring lags
+    float offset = 0;
+    if(best > 0 && best < LAGS - 1) {
+        float denom = r[best-1] - 2*r[best] + r[best+1];
+        if(denom != 0) {
+            offset = 0.5f * (r[best-1] - r[best+1]) / denom;
+        }
+    }
+    return MIN_LAG + best + offset;
+}
+
+static void seed(startup_t * ST, pulse_sensor_t * PS, float period) {
+    uint32_t IBI = (uint32_t)(period * STARTUP_PERIOD_MS + 0.5f);
+    uint16_t last_period = (uint16_t)(period + 0.5f);
+
+    // peak and trough of the most recent beat
+    float peak = ST->samples[ST->count - 1];
+    float trough = peak;
+    for(uint16_t i = ST->count - last_period; i < ST->count; i++) {
+        peak = ST->samples[i] > peak ? ST->samples[i] : peak;
+        trough = ST->samples[i] < trough ? ST->samples[i] : trough;
+    }
+    float thresh = trough + (peak - trough) / 2; // 50% of amplitude, same as a finished beat
+
+    // most recent rising crossing of thresh is the last beat
+    uint16_t samples_since_beat = 0;
+    for(uint16_t i = ST->count - 1; i > 0; i--) {
+        if(ST->samples[i-1] <= thresh && ST->samples[i] > thresh) {
+            samples_since_beat = ST->count - 1 - i;
+            break;
+        }
+    }
+    uint64_t since_beat = (uint64_t)samples_since_beat * STARTUP_PERIOD_MS + ST->accumulated_ms;
+
+    for(uint8_t i = 0; i < PULSE_RATE_WINDOW; i++) {
+        PS->rate[i] = IBI;
+    }
+    PS->IBI = IBI;
+    PS->BPM = 60000 / IBI;
+    PS->amplitude = peak - trough;
+    PS->thresh = thresh;
+    PS->peak = PS->signal > thresh ? PS->signal : thresh;
+    PS->trough = thresh;
+    PS->pulse = PS->signal > thresh; // may already be inside the next beat
+    PS->last_beat_time = since_beat < PS->sample_counter ? PS->sample_counter - since_beat : 0;
+    PS->N = PS->sample_counter - PS->last_beat_time;
+    PS->beat_offset = 0;
+    PS->first_beat = false; // the next IBI is measured from a real beat
+    PS->second_beat = false;
+    PS->warm_start = false;
+}
+
+/*
+    @brief startup estimator initialization
+    @note call right after heart_rate_init()
+    @param Startup Pointer to startup estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void startup_init(startup_t * ST, pulse_sensor_t * PS) {
+    restart(ST, PS);
+}
+
+/*
+    @brief buffers the latest sample and seeds the pulse sensor once the window is full
+    @note call right after pulse_sensor_process_sample(), buffering starts again after every reset
+    @param Startup Pointer to startup estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval true if the pulse sensor was seeded by this sample
+*/
+bool startup_process_sample(startup_t * ST, pulse_sensor_t * PS, uint32_t ms) {
+    if(PS->reset_count != ST->reset_count) {
+        ST->reset_count = PS->reset_count;
+        if(ST->done) {
+            restart(ST, PS); // the reset threw away all state, look back again
+        }
+    }
+
+    if(ST->done) {
+        return false;
+    }
+
+    ST->accumulator += PS->signal;
+    ST->accumulated++;
+    ST->accumulated_ms += ms;
+
+    if(ST->accumulated_ms < STARTUP_PERIOD_MS) {
+        return false;
+    }
+
+    ST->samples[ST->count++] = ST->accumulator / ST->accumulated;
+    ST->accumulator = 0;
+    ST->accumulated = 0;
+    ST->accumulated_ms -= STARTUP_PERIOD_MS;
+
+    if(ST->count < STARTUP_SAMPLES) {
+        return false;
+    }
+
+    ST->done = true;
+    if(PS->BPM > 0) {
+        return false; // detector already has a BPM of its own
+    }
+
+    float period = estimate_period(ST);
+    if(period == 0) {
+        return false;
+    }
+
+    seed(ST, PS, period);
+    ST->seeded = true;
+    return true;
+}
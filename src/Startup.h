@@ -0,0 +1,70 @@
+/* ****************************************************************************/
+/** Heart Rate Sensor Startup Estimator
+
+  @File Name
+    Startup.h
+
+  @Summary
+    Seeds the pulse sensor from a look-back estimate over the first seconds
+
+  @Description
+    Defines functions that buffer the first few seconds of signal (and the
+    first seconds after every reset), run a one-shot autocorrelation over the
+    buffer and seed rate, thresh and IBI so BPM is reported sooner
+******************************************************************************/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include "HeartRate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STARTUP_PERIOD_MS 20 // samples are averaged down to this period (50 Hz) before buffering
+#define STARTUP_WINDOW_MS 3000 // look-back window
+#define STARTUP_SAMPLES (STARTUP_WINDOW_MS / STARTUP_PERIOD_MS)
+#define STARTUP_MIN_BPM 40
+#define STARTUP_MAX_BPM 220
+#define STARTUP_MIN_CORRELATION 0.5f // estimate is not used below this normalized correlation
+
+typedef struct {
+    // startup output variables
+    bool done; // true once the estimate for the current window was made
+    bool seeded; // true if the estimate was used to seed the pulse sensor
+    float correlation; // normalized correlation of the estimate, 0-1
+
+    // startup internal variables
+    float samples[STARTUP_SAMPLES]; // decimated samples since init or reset
+    uint16_t count; // samples in the buffer
+    float accumulator; // sum of samples being decimated
+    uint16_t accumulated; // number of samples in accumulator
+    uint32_t accumulated_ms; // time (ms) covered by accumulator
+    uint32_t reset_count; // pulse sensor reset count when buffering started
+}startup_t;
+
+/*
+    @brief startup estimator initialization
+    @note call right after heart_rate_init()
+    @param Startup Pointer to startup estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @retval None
+*/
+void startup_init(startup_t * Startup, pulse_sensor_t * Pulse_Sensor);
+
+/*
+    @brief buffers the latest sample and seeds the pulse sensor once the window is full
+    @note call right after pulse_sensor_process_sample(), buffering starts again after every reset
+    @param Startup Pointer to startup estimator handler
+    @param Pulse Sensor Pointer to pulse sensor handler
+    @param ms time (ms) since the last sample
+    @retval true if the pulse sensor was seeded by this sample
+*/
+bool startup_process_sample(startup_t * Startup, pulse_sensor_t * Pulse_Sensor, uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STARTUP_H
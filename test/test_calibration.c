@@ -0,0 +1,64 @@
+/* ****************************************************************************/
+/** Threshold Calibration Test
+
+  @File Name
+    test_calibration.c
+
+  @Summary
+    Checks the rate read after calibration across resting and raised rates
+
+  @Description
+    Build and run from the repository root:
+      gcc -std=c99 -Wall -Wextra -Isrc test/test_calibration.c src/Calibration.c src/HeartRate.c -lm -o test_calibration && ./test_calibration
+******************************************************************************/
+
+#include "Calibration.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SAMPLE_MS 2
+#define RUN_MS 20000
+
+// PPG like pulse, systolic peak and a smaller dicrotic wave
+static float ppg(uint32_t t, uint32_t beat_ms) {
+    float p = (float)(t % beat_ms) / beat_ms;
+    float systolic = (p - 0.15f) / 0.06f;
+    float dicrotic = (p - 0.45f) / 0.08f;
+    return 0.45f + 0.35f * expf(-systolic * systolic) + 0.1f * expf(-dicrotic * dicrotic);
+}
+
+// calibrates on a pulse at bpm and returns the failures
+static int check_rate(uint8_t bpm) {
+    uint32_t beat_ms = 60000 / bpm;
+    pulse_sensor_t ps;
+    heart_rate_init(&ps);
+    calibration_t calibration;
+    calibration_init(&calibration, &ps);
+
+    for(uint32_t t = 0; t < RUN_MS; t += SAMPLE_MS) {
+        ps.signal = ppg(t, beat_ms);
+        calibration_process_sample(&calibration, &ps, SAMPLE_MS);
+    }
+
+    int failures = 0;
+    if(ps.BPM < bpm - 2 || ps.BPM > bpm + 2) {
+        printf("FAIL: BPM %u, expected %u\n", ps.BPM, bpm);
+        failures++;
+    }
+    if(ps.reset_count != 0 || calibration.calibrations != 1) {
+        printf("FAIL: %u resets and %u calibrations at %u BPM\n", ps.reset_count, calibration.calibrations, bpm);
+        failures++;
+    }
+    return failures;
+}
+
+int main(void) {
+    const uint8_t rates[] = {50, 75, 90, 105, 120}; // above 80 BPM the first IBI must not span the calibration
+    int failures = 0;
+    for(uint8_t i = 0; i < sizeof(rates); i++) {
+        failures += check_rate(rates[i]);
+    }
+
+    printf("%s: %u rates\n", failures ? "FAILED" : "PASSED", (unsigned)sizeof(rates));
+    return failures != 0;
+}
@@ -0,0 +1,117 @@
+/* ****************************************************************************/
+/** Low Power Mode Test
+
+  @File Name
+    test_low_power.c
+
+  @Summary
+    Drives the comparator/refractory state machine with a software comparator
+
+  @Description
+    Build and run from the repository root:
+      gcc -std=c99 -Wall -Wextra -Isrc test/test_low_power.c src/LowPower.c src/HeartRate.c -lm -o test_low_power && ./test_low_power
+******************************************************************************/
+
+#include "LowPower.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SAMPLE_MS 2
+#define BEAT_MS 800 // 75 BPM
+#define PULSE_MS 20000 // pulses, then a flat signal
+
+// PPG like pulse, systolic peak and a smaller dicrotic wave
+static float ppg(uint32_t t) {
+    float p = (float)(t % BEAT_MS) / BEAT_MS;
+    float systolic = (p - 0.15f) / 0.06f;
+    float dicrotic = (p - 0.45f) / 0.08f;
+    return 0.45f + 0.35f * expf(-systolic * systolic) + 0.1f * expf(-dicrotic * dicrotic);
+}
+
+int main(void) {
+    pulse_sensor_t ps;
+    ps.thresh_setting = 0.55f;
+    heart_rate_init(&ps);
+
+    soft_comparator_t sc;
+    low_power_t lp;
+    low_power_init(&lp, &ps, soft_comparator_interface(&sc), 0.02f, 100);
+
+    int failures = 0;
+    uint32_t adc_samples = 0;
+    uint32_t ticks = 0;
+    uint32_t since = 0; // ms since the last low power call
+    uint32_t sleep = low_power_sleep_time(&lp);
+    bool bursting = false;
+    bool armed_in_refractory = false;
+    bool signal_lost = false;
+    uint8_t bpm = 0;
+    float last_adc = 0;
+
+    for(uint32_t t = 0; t < PULSE_MS + 4000; t += SAMPLE_MS, ticks++) {
+        float s = t < PULSE_MS ? ppg(t) : 0.45f;
+        if(t == PULSE_MS) {
+            bpm = ps.BPM;
+        }
+
+        if(bursting) {
+            ps.signal = last_adc = s;
+            adc_samples++;
+            if(!low_power_process_burst_sample(&lp, SAMPLE_MS)) {
+                bursting = false;
+                since = 0;
+                sleep = low_power_sleep_time(&lp);
+            }
+            continue;
+        }
+
+        // asleep, only the comparator sees the signal
+        since += SAMPLE_MS;
+        if(lp.state == LOW_POWER_REFRACTORY && sc.armed) {
+            armed_in_refractory = true;
+        }
+        if(soft_comparator_input(&sc, s)) {
+            ps.signal = last_adc = s;
+            adc_samples++;
+            low_power_on_crossing(&lp, since);
+            since = 0;
+            bursting = true;
+        }
+        else if(since >= sleep) {
+            low_power_on_timer(&lp, since);
+            since = 0;
+            sleep = low_power_sleep_time(&lp);
+            if(ps.signal != last_adc) {
+                signal_lost = true; // a timer wake-up must not make up a sample
+            }
+        }
+    }
+
+    if(bpm < 73 || bpm > 77) {
+        printf("FAIL: BPM %u, expected 75\n", bpm);
+        failures++;
+    }
+    if(adc_samples * 2 > ticks) {
+        printf("FAIL: ADC sampled %u of %u ticks\n", adc_samples, ticks);
+        failures++;
+    }
+    if(armed_in_refractory) {
+        printf("FAIL: comparator armed during the refractory window\n");
+        failures++;
+    }
+    if(signal_lost) {
+        printf("FAIL: timer wake-up changed the latest sample\n");
+        failures++;
+    }
+    if(ps.reset_count == 0 || ps.BPM != 0) {
+        printf("FAIL: no reset after the pulse stopped\n");
+        failures++;
+    }
+    if(lp.state != LOW_POWER_ARMED || !sc.armed || sc.level != ps.thresh_setting) {
+        printf("FAIL: comparator not re-armed at thresh_setting after the reset\n");
+        failures++;
+    }
+
+    printf("%s: BPM %u, ADC on %u of %u ticks, %u resets\n", failures ? "FAILED" : "PASSED", bpm, adc_samples, ticks, ps.reset_count);
+    return failures != 0;
+}
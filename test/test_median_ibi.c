@@ -0,0 +1,59 @@
+/* ****************************************************************************/
+/** Median IBI Step Change Test
+
+  @File Name
+    test_median_ibi.c
+
+  @Summary
+    Checks the median IBI follows a real rate change and still rejects outliers
+
+  @Description
+    Build and run from the repository root:
+      gcc -std=c99 -Wall -Wextra -Isrc test/test_median_ibi.c src/MedianIBI.c -o test_median_ibi && ./test_median_ibi
+******************************************************************************/
+
+#include "MedianIBI.h"
+#include <stdio.h>
+
+int main(void) {
+    median_ibi_t m;
+    median_ibi_init(&m);
+    int failures = 0;
+
+    for(int i = 0; i < 30; i++) {
+        median_ibi_add_beat(&m, 800 + (i % 3) * 5);
+    }
+
+    // single outliers are still rejected
+    if(median_ibi_add_beat(&m, 400) || median_ibi_add_beat(&m, 1600)) {
+        printf("FAIL: outlier accepted\n");
+        failures++;
+    }
+    median_ibi_add_beat(&m, 805);
+
+    // 800 -> 500 ms step, the median must follow within one window
+    int beats = 0;
+    for(; beats < 60 && get_median_inter_beat_interval(&m) > 520; beats++) {
+        median_ibi_add_beat(&m, 500 + (beats % 3) * 5);
+    }
+    if(get_median_inter_beat_interval(&m) > 520 || beats > MEDIAN_IBI_WINDOW + MEDIAN_IBI_MAX_REJECTS) {
+        printf("FAIL: median %u after %d beats of the new rate\n", get_median_inter_beat_interval(&m), beats);
+        failures++;
+    }
+
+    // after relocking, beats of the new rate pass and outliers are rejected again
+    for(int i = 0; i < 20; i++) {
+        if(!median_ibi_add_beat(&m, 500 + (i % 3) * 5)) {
+            printf("FAIL: beat of the new rate rejected\n");
+            failures++;
+            break;
+        }
+    }
+    if(median_ibi_add_beat(&m, 1000)) {
+        printf("FAIL: outlier accepted after the step\n");
+        failures++;
+    }
+
+    printf("%s: relocked after %d beats\n", failures ? "FAILED" : "PASSED", beats);
+    return failures != 0;
+}
@@ -0,0 +1,64 @@
+/* ****************************************************************************/
+/** Snapshot Size Test
+
+  @File Name
+    test_snapshot.c
+
+  @Summary
+    Checks snapshots stay inside PULSE_SNAPSHOT_SIZE and restore for any rate window
+
+  @Description
+    Build and run from the repository root, with the default and a non-default window:
+      gcc -std=c99 -Wall -Wextra -Isrc test/test_snapshot.c src/Snapshot.c src/HeartRate.c -lm -o test_snapshot && ./test_snapshot
+      gcc -std=c99 -Wall -Wextra -DPULSE_RATE_WINDOW=20 -Isrc test/test_snapshot.c src/Snapshot.c src/HeartRate.c -lm -o test_snapshot && ./test_snapshot
+******************************************************************************/
+
+#include "Snapshot.h"
+#include <stdio.h>
+#include <string.h>
+
+#define GUARD 16
+
+int main(void) {
+    pulse_sensor_t ps;
+    ps.thresh_setting = 0.55f; // heart_rate_init() seeds thresh from it
+    heart_rate_init(&ps);
+    for(uint32_t i = 0; i < 5000; i++) {
+        ps.signal = (i % 400) < 40 ? 0.9f : 0.5f; // 75 BPM square pulses, 2 ms samples
+        pulse_sensor_process_sample(&ps, 2);
+    }
+
+    int failures = 0;
+    uint8_t buffer[PULSE_SNAPSHOT_SIZE + GUARD];
+    memset(buffer, 0xA5, sizeof(buffer));
+
+    if(pulse_sensor_snapshot(&ps, buffer, PULSE_SNAPSHOT_SIZE - 1) != 0) {
+        printf("FAIL: snapshot written to a short buffer\n");
+        failures++;
+    }
+    size_t size = pulse_sensor_snapshot(&ps, buffer, PULSE_SNAPSHOT_SIZE);
+    if(size != PULSE_SNAPSHOT_SIZE) {
+        printf("FAIL: wrote %u bytes, PULSE_SNAPSHOT_SIZE is %u\n", (unsigned)size, (unsigned)PULSE_SNAPSHOT_SIZE);
+        failures++;
+    }
+    for(size_t i = PULSE_SNAPSHOT_SIZE; i < sizeof(buffer); i++) {
+        if(buffer[i] != 0xA5) {
+            printf("FAIL: wrote past PULSE_SNAPSHOT_SIZE\n");
+            failures++;
+            break;
+        }
+    }
+
+    pulse_sensor_t restored;
+    if(!pulse_sensor_restore(&restored, buffer, PULSE_SNAPSHOT_SIZE)) {
+        printf("FAIL: snapshot did not restore\n");
+        failures++;
+    }
+    else if(restored.BPM != ps.BPM || restored.sample_counter != ps.sample_counter || memcmp(restored.rate, ps.rate, sizeof(ps.rate)) != 0) {
+        printf("FAIL: restored state differs\n");
+        failures++;
+    }
+
+    printf("%s: PULSE_RATE_WINDOW %d, %u byte snapshot, BPM %u\n", failures ? "FAILED" : "PASSED", PULSE_RATE_WINDOW, (unsigned)size, ps.BPM);
+    return failures != 0;
+}